@@ -0,0 +1,320 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "BinaryGCode.hpp"
+#include "GCodeTokenizer.hpp"
+#include <sstream>
+#include <cstring>
+#include <cmath>
+
+#define FIELD_N 0x0001
+#define FIELD_M 0x0002
+#define FIELD_G 0x0004
+#define FIELD_X 0x0008
+#define FIELD_Y 0x0010
+#define FIELD_Z 0x0020
+#define FIELD_E 0x0040
+#define FIELD_BINARY 0x0080
+#define FIELD_F 0x0100
+#define FIELD_T 0x0200
+#define FIELD_S 0x0400
+#define FIELD_P 0x0800
+#define FIELD_V2 0x1000
+#define FIELD_TEXT 0x8000
+#define FIELD2_I 0x0001
+#define FIELD2_J 0x0002
+#define FIELD2_R 0x0004
+
+#define V1_TEXT_LENGTH 16
+
+/*
+ * Encode one line (with or without line number and checksum) into a
+ * packet. Version 2 packets are only used if the line needs them.
+ * Returns: 0 on success, -1 if the line can not be encoded with the
+ *          given protocol version
+ */
+int BinaryGCode::encode(const string& line, int version, string& packet)
+{
+	if(version<BINARY_PROTOCOL_V1)
+		return -1;
+	int fields=FIELD_BINARY;
+	int fields2=0;
+	long n=0, m=0, g=0, t=0, s=0, p=0;
+	double floats[8];  // X Y Z E F I J R
+	string text;
+	GCodeTokenizer tokenizer(line.c_str(), line.length());
+	GCodeWord word;
+	int result;
+	while((result=tokenizer.next(word))>0)
+	{
+		if(word.letter=='*')
+			continue;
+		if(!word.hasValue)
+			return -1;
+		char letter=word.letter;
+		double value=word.value;
+		int field=0;
+		int field2=0;
+		int index=-1;
+		switch(letter)
+		{
+		case 'N': field=FIELD_N; n=(long)value; break;
+		case 'M': field=FIELD_M; m=(long)value; break;
+		case 'G': field=FIELD_G; g=(long)value; break;
+		case 'T': field=FIELD_T; t=(long)value; break;
+		case 'S': field=FIELD_S; s=(long)value; break;
+		case 'P': field=FIELD_P; p=(long)value; break;
+		case 'X': field=FIELD_X; index=0; break;
+		case 'Y': field=FIELD_Y; index=1; break;
+		case 'Z': field=FIELD_Z; index=2; break;
+		case 'E': field=FIELD_E; index=3; break;
+		case 'F': field=FIELD_F; index=4; break;
+		case 'I': field2=FIELD2_I; index=5; break;
+		case 'J': field2=FIELD2_J; index=6; break;
+		case 'R': field2=FIELD2_R; index=7; break;
+		default:
+			return -1;
+		}
+		if((fields & field) || (fields2 & field2))
+			return -1;  // the same word twice
+		if(index>=0)
+			floats[index]=value;
+		else if(value!=floor(value) || fabs(value)>2147483647.0)
+			return -1;  // integer fields with fractions or too large
+		fields|=field;
+		fields2|=field2;
+		if(field==FIELD_M && hasText(m))
+		{
+			// the rest of the line is the argument (a file name or message)
+			size_t textBegin, textEnd;
+			tokenizer.readText(textBegin, textEnd);
+			text=line.substr(textBegin, textEnd-textBegin);
+			if(text.length())
+				fields|=FIELD_TEXT;
+		}
+	}
+	if(result<0)
+		return -1;
+	if(!(fields & (FIELD_M | FIELD_G | FIELD_T)))
+		return -1;
+	if(m<0 || g<0 || n<0 || t<0 || t>255 || m>65535 || g>65535)
+		return -1;
+	bool v2=fields2!=0 || m>255 || g>255 || ((fields & FIELD_TEXT) && text.length()>V1_TEXT_LENGTH);
+	if(v2 && version<BINARY_PROTOCOL_V2)
+		return -1;
+	if(text.length()>255)
+		return -1;
+	if(v2)
+		fields|=FIELD_V2;
+
+	packet.clear();
+	putInt(packet, fields, 2);
+	if(v2)
+	{
+		putInt(packet, fields2, 2);
+		if(fields & FIELD_TEXT)
+			putInt(packet, text.length(), 1);
+	}
+	if(fields & FIELD_N)
+		putInt(packet, n & 0xffff, 2);  // the firmware compares the low 16 bits
+	if(fields & FIELD_M)
+		putInt(packet, m, v2 ? 2 : 1);
+	if(fields & FIELD_G)
+		putInt(packet, g, v2 ? 2 : 1);
+	if(fields & FIELD_X)
+		putFloat(packet, floats[0]);
+	if(fields & FIELD_Y)
+		putFloat(packet, floats[1]);
+	if(fields & FIELD_Z)
+		putFloat(packet, floats[2]);
+	if(fields & FIELD_E)
+		putFloat(packet, floats[3]);
+	if(fields & FIELD_F)
+		putFloat(packet, floats[4]);
+	if(fields & FIELD_T)
+		putInt(packet, t, 1);
+	if(fields & FIELD_S)
+		putInt(packet, (unsigned long)s, 4);
+	if(fields & FIELD_P)
+		putInt(packet, (unsigned long)p, 4);
+	if(fields2 & FIELD2_I)
+		putFloat(packet, floats[5]);
+	if(fields2 & FIELD2_J)
+		putFloat(packet, floats[6]);
+	if(fields2 & FIELD2_R)
+		putFloat(packet, floats[7]);
+	if(fields & FIELD_TEXT)
+	{
+		packet+=text;
+		if(!v2)
+			packet.append(V1_TEXT_LENGTH-text.length(), '\0');
+	}
+	unsigned int sum1=0, sum2=0;
+	for(size_t i=0; i<packet.length(); i++)
+	{
+		sum1=(sum1+(unsigned char)packet[i])%255;
+		sum2=(sum2+sum1)%255;
+	}
+	putInt(packet, sum1, 1);
+	putInt(packet, sum2, 1);
+	return 0;
+}
+
+/*
+ * Get the size of the packet starting at data, which holds length
+ * received bytes.
+ * Returns: The size of the packet including the checksum, 0 if more
+ *          bytes are needed to know it, -1 if data is no packet
+ */
+int BinaryGCode::packetSize(const char* data, size_t length)
+{
+	const unsigned char* bytes=(const unsigned char*)data;
+	if(length<2)
+		return length>0 && !(bytes[0] & FIELD_BINARY) ? -1 : 0;
+	int fields=getInt(bytes, 2);
+	if(!(fields & FIELD_BINARY))
+		return -1;
+	bool v2=fields & FIELD_V2;
+	int fields2=0;
+	int size=2;
+	int textLength=V1_TEXT_LENGTH;
+	if(v2)
+	{
+		if(length<4)
+			return 0;
+		fields2=getInt(bytes+2, 2);
+		size+=2;
+		if(fields & FIELD_TEXT)
+		{
+			if(length<5)
+				return 0;
+			textLength=bytes[4];
+			size++;
+		}
+	}
+	int intSize=v2 ? 2 : 1;
+	if(fields & FIELD_N) size+=2;
+	if(fields & FIELD_M) size+=intSize;
+	if(fields & FIELD_G) size+=intSize;
+	if(fields & FIELD_X) size+=4;
+	if(fields & FIELD_Y) size+=4;
+	if(fields & FIELD_Z) size+=4;
+	if(fields & FIELD_E) size+=4;
+	if(fields & FIELD_F) size+=4;
+	if(fields & FIELD_T) size+=1;
+	if(fields & FIELD_S) size+=4;
+	if(fields & FIELD_P) size+=4;
+	if(fields2 & FIELD2_I) size+=4;
+	if(fields2 & FIELD2_J) size+=4;
+	if(fields2 & FIELD2_R) size+=4;
+	if(fields & FIELD_TEXT) size+=textLength;
+	return size+2;
+}
+
+/*
+ * Convert a complete packet back into an ASCII line without checksum,
+ * for example "N12 G1 X10 Y20.5".
+ * Returns: 0 on success, -1 if the packet is invalid or its checksum
+ *          does not match
+ */
+int BinaryGCode::decode(const char* data, size_t length, string& line)
+{
+	int size=packetSize(data, length);
+	if(size<=0 || (size_t)size>length)
+		return -1;
+	const unsigned char* bytes=(const unsigned char*)data;
+	unsigned int sum1=0, sum2=0;
+	for(int i=0; i<size-2; i++)
+	{
+		sum1=(sum1+bytes[i])%255;
+		sum2=(sum2+sum1)%255;
+	}
+	if(sum1!=bytes[size-2] || sum2!=bytes[size-1])
+		return -1;
+	int fields=getInt(bytes, 2);
+	bool v2=fields & FIELD_V2;
+	int fields2=0;
+	size_t textLength=V1_TEXT_LENGTH;
+	const unsigned char* pos=bytes+2;
+	if(v2)
+	{
+		fields2=getInt(pos, 2);
+		pos+=2;
+		if(fields & FIELD_TEXT)
+			textLength=*pos++;
+	}
+	int intSize=v2 ? 2 : 1;
+	ostringstream stream;
+	if(fields & FIELD_N) { stream<<"N"<<getInt(pos, 2)<<" "; pos+=2; }
+	if(fields & FIELD_M) { stream<<"M"<<getInt(pos, intSize)<<" "; pos+=intSize; }
+	if(fields & FIELD_G) { stream<<"G"<<getInt(pos, intSize)<<" "; pos+=intSize; }
+	if(fields & FIELD_X) { stream<<"X"<<getFloat(pos)<<" "; pos+=4; }
+	if(fields & FIELD_Y) { stream<<"Y"<<getFloat(pos)<<" "; pos+=4; }
+	if(fields & FIELD_Z) { stream<<"Z"<<getFloat(pos)<<" "; pos+=4; }
+	if(fields & FIELD_E) { stream<<"E"<<getFloat(pos)<<" "; pos+=4; }
+	if(fields & FIELD_F) { stream<<"F"<<getFloat(pos)<<" "; pos+=4; }
+	if(fields & FIELD_T) { stream<<"T"<<getInt(pos, 1)<<" "; pos+=1; }
+	if(fields & FIELD_S) { stream<<"S"<<(long)(int)getInt(pos, 4)<<" "; pos+=4; }
+	if(fields & FIELD_P) { stream<<"P"<<(long)(int)getInt(pos, 4)<<" "; pos+=4; }
+	if(fields2 & FIELD2_I) { stream<<"I"<<getFloat(pos)<<" "; pos+=4; }
+	if(fields2 & FIELD2_J) { stream<<"J"<<getFloat(pos)<<" "; pos+=4; }
+	if(fields2 & FIELD2_R) { stream<<"R"<<getFloat(pos)<<" "; pos+=4; }
+	if(fields & FIELD_TEXT)
+		stream<<string((const char*)pos, strnlen((const char*)pos, textLength));
+	line=stream.str();
+	while(line.length() && line[line.length()-1]==' ')
+		line.erase(line.length()-1);
+	return 0;
+}
+
+void BinaryGCode::putInt(string& packet, unsigned long value, int bytes)
+{
+	for(int i=0; i<bytes; i++)
+		packet+=(char)((value>>(8*i)) & 0xff);
+}
+
+void BinaryGCode::putFloat(string& packet, double value)
+{
+	float single=(float)value;
+	unsigned int bits;
+	memcpy(&bits, &single, 4);
+	putInt(packet, bits, 4);
+}
+
+unsigned long BinaryGCode::getInt(const unsigned char* data, int bytes)
+{
+	unsigned long value=0;
+	for(int i=0; i<bytes; i++)
+		value|=(unsigned long)data[i]<<(8*i);
+	return value;
+}
+
+float BinaryGCode::getFloat(const unsigned char* data)
+{
+	unsigned int bits=getInt(data, 4);
+	float single;
+	memcpy(&single, &bits, 4);
+	return single;
+}
+
+/*
+ * Returns: true for M-codes which take the rest of the line as text
+ */
+bool BinaryGCode::hasText(int m)
+{
+	return m==23 || m==28 || m==29 || m==30 || m==32 || m==117;
+}
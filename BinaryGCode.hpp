@@ -0,0 +1,66 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BINARYGCODE_HPP_
+#define BINARYGCODE_HPP_
+
+#include <string>
+#include <cstddef>
+
+#define BINARY_PROTOCOL_NONE 0  // send ASCII lines
+#define BINARY_PROTOCOL_V1 1
+#define BINARY_PROTOCOL_V2 2
+
+using namespace std;
+
+/*
+ * BinaryGCode converts G-code lines to and from the binary protocol
+ * of the Repetier firmware (REPETIER_PROTOCOL 1 and 2 in the M115
+ * answer). A packet is, all values little endian:
+ *   uint16 fields    bit 0 N, 1 M, 2 G, 3 X, 4 Y, 5 Z, 6 E, 7 always
+ *                    set (binary marker), 8 F, 9 T, 10 S, 11 P,
+ *                    12 version 2, 15 text
+ *   uint16 fields2   version 2 only: bit 0 I, 1 J, 2 R
+ *   uint8 textLength version 2 with text only
+ *   uint16 N
+ *   M, G             uint8 in version 1, uint16 in version 2
+ *   float X Y Z E F
+ *   uint8 T
+ *   int32 S P
+ *   float I J R
+ *   text
+ *   uint8 sum1, sum2 Fletcher-16 checksum of all bytes before
+ * Version 1 has no I, J, R and a fixed text length of 16 bytes.
+ * encode() fails for lines which can not be expressed in a packet, the
+ * caller sends them as ASCII lines instead.
+ */
+class BinaryGCode
+{
+public:
+	static int encode(const string& line, int version, string& packet);
+	static int packetSize(const char* data, size_t length);
+	static int decode(const char* data, size_t length, string& line);
+	static bool hasText(int m);
+
+private:
+	static void putInt(string& packet, unsigned long value, int bytes);
+	static void putFloat(string& packet, double value);
+	static unsigned long getInt(const unsigned char* data, int bytes);
+	static float getFloat(const unsigned char* data);
+};
+
+#endif /* BINARYGCODE_HPP_ */
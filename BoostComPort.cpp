@@ -20,43 +20,82 @@ along with BoostComPort.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "BoostComPort.hpp"
 #include <boost/bind.hpp>
+#include <cstring>
+#ifndef _WIN32
+#include <pthread.h>
+#endif
 
-BoostComPort::BoostComPort():
-currentContent(0),
-serialPort(io_service),
-consoleStream(&consoleStreamBuffer),
-streamEnabled(false)
+/*
+ * Without arguments the port has its own io_service and a receive
+ * buffer of BUFFER_SIZE bytes. Many ports can share one io_service
+ * which is run by the caller (see PrinterFarm), their receive buffers
+ * only need to hold the answers which arrive between two polls.
+ */
+BoostComPort::BoostComPort(boost::asio::io_service* sharedService, size_t bufferSize):
+buffer(bufferSize),
+lineBuffer(NULL),
+readBuffer(&buffer),
+searchedUntil(0),
+pendingRead(NULL),
+readRunning(false),
+io_service(sharedService ? *sharedService : ownService),
+transport(NULL),
+connectionLost(false),
+bytesSent(0),
+bytesReceived(0),
+readEvents(0),
+baud(0),
+ioThreadEnabled(false),
+ioThreadPriority(0),
+ioThreadRunning(false),
+ioThread(NULL),
+ioWork(NULL),
+rxQueue(NULL),
+txQueue(NULL),
+rxStalled(false),
+receiveRetry(NULL)
 {
 	lastError.clear();
-	buffer=new char[BUFFER_SIZE];
-	eventBuffer=new char[EVENTBUFFER_SIZE];
 }
 
 BoostComPort::~BoostComPort()
 {
-	serialPort.close();
-	delete[] buffer;
-	delete[] eventBuffer;
+	close();
+	delete lineBuffer;
+	delete rxQueue;
+	delete txQueue;
+	delete receiveRetry;
 }
 
 /*
  * Opens a new com port connection.
  * No flow control setting supported so far. You just set the port name
  * and the baud rate. The port name is something like COMx on Windows
- * or /dev/ttySx on Linux.
+ * or /dev/ttySx on Linux. Instead of a port name an URI for any other
+ * transport can be given, see Transport.hpp.
  * Returns: 0 if the port is opened
  */
 int BoostComPort::open(std::string port, int baud)
 {
 	try
 	{
-		if(serialPort.is_open())
+		if(transport)
 			close();
-		serialPort.open(port);
-		boost::asio::serial_port_base::baud_rate baudRate(baud);
-		serialPort.set_option(baudRate);
+		transport=Transport::create(port, baud, io_service);
+		if(!transport)
+			return -1;
+		this->baud=baud;
+		connectionLost=false;
+		if(transport->open())
+		{
+			delete transport;
+			transport=NULL;
+			return -1;
+		}
 		io_service.reset();
-		serialPort.async_read_some(boost::asio::buffer(eventBuffer, EVENTBUFFER_SIZE), boost::bind(&BoostComPort::onPortRead, this, _1, _2));
+		buffer.clear();
+		searchedUntil=0;
+		startRead();
 		char* tmp=new char[100]; // 100Bytes of temporary buffer to clean the system buffers
 		int read;
 		do  // TODO: I think here is missing a timeout or something like that
@@ -64,6 +103,8 @@ int BoostComPort::open(std::string port, int baud)
 			read=this->read(tmp, 100, false);
 		} while(read>0);
 		delete[] tmp;
+		if(ioThreadEnabled && &io_service==&ownService)  // a shared io_service is run by its owner
+			startIoThread();
 		return 0;
 	}
 	catch(...)
@@ -76,11 +117,18 @@ int BoostComPort::open(std::string port, int baud)
  * Get the last error.
  * Returns: Reference to the last boost error
  */
-boost::system::error_code& BoostComPort::getLastError()
+boost::system::error_code BoostComPort::getLastError()
 {
+	boost::mutex::scoped_lock lock(errorMutex);
 	return lastError;
 }
 
+void BoostComPort::setLastError(const boost::system::error_code& error)
+{
+	boost::mutex::scoped_lock lock(errorMutex);
+	lastError=error;
+}
+
 /*
  * Close the port.
  * Returns: Always 0 at the moment, -1 if an error occurred (may be
@@ -89,33 +137,140 @@ boost::system::error_code& BoostComPort::getLastError()
 int BoostComPort::close()
 {
 	//serialPort.cancel();  // make shure all pending operations are stopped
+	stopIoThread();
+	if(!transport)
+		return 0;
 	boost::system::error_code ec;
-	serialPort.close(ec);
+	transport->close(ec);
+	io_service.reset();  // don't know why this is needed but without it's not working
+	io_service.poll();  // let the cancelled read finish before the ring is reset
+	delete transport;
+	transport=NULL;
+	buffer.consume(buffer.size());
+	searchedUntil=0;
 	if(ec)
-	{
-		currentContent=0;
 		return -1;
-	}
-	io_service.reset();  // don't know why this is needed but without it's not working
-	currentContent=0;
 	return 0;
 }
 
+/*
+ * Returns: false if the port is closed or the connection was closed by
+ *          the other side (the port has to be closed and opened again)
+ */
 bool BoostComPort::isOpended()
 {
-	return serialPort.is_open();
+	return transport && !connectionLost && transport->isOpen();
+}
+
+/*
+ * Returns: The name of the open port, for a pseudo-terminal the device
+ *          the other side has to open
+ */
+string BoostComPort::getName()
+{
+	if(!transport)
+		return "";
+	return transport->getName();
 }
 
+/*
+ * Get the file descriptor of the open port, for example to wait for
+ * received data in an other event loop.
+ * Returns: The file descriptor or -1 if the port is not open or there
+ *          is no file descriptor (Windows)
+ */
+int BoostComPort::getNativeHandle()
+{
+	if(!transport)
+		return -1;
+	return transport->getNativeHandle();
+}
+
+/*
+ * Write data to the serial port.
+ * Without the I/O thread the data is written synchronously. With the
+ * I/O thread it is queued and written by the thread, errors are then
+ * only reported by getLastError().
+ */
 int BoostComPort::write(char* data, unsigned int length)
 {
-	size_t written=boost::asio::write(serialPort, boost::asio::buffer(data, length), boost::asio::transfer_all(), ec);
+	if(ioThreadRunning)
+	{
+		queueWrite(data, length);
+		requestFlush();
+		return 0;
+	}
+	if(writeData(data, length, ec))
+	{
+		setLastError(ec);
+		return -1;
+	}
+	return 0;
+}
+
+int BoostComPort::writeData(const char* data, size_t length, boost::system::error_code& error)
+{
+	if(!transport)
+		return -1;
+	vector<boost::asio::const_buffer> buffers(1, boost::asio::buffer(data, length));
+	size_t written=transport->write(buffers, error);
+	bytesSent+=written;
+	if(written!=length)
+	{
+		cerr<<"Failed to write all data to serial port!"<<endl;
+		return -1;
+	}
+	consoleTap.write(data, length, true);
+	return 0;
+}
+
+/*
+ * Write several lines with one gather write (writev), without
+ * concatenating them first. The lines are written in the given order
+ * and have to contain their line end already. Like write() the lines
+ * are queued for the I/O thread if it is used.
+ * Returns: 0 if all lines are written (queued), -1 otherwise
+ */
+int BoostComPort::writeLines(const vector<string>& lines)
+{
+	if(lines.empty())
+		return 0;
+	if(ioThreadRunning)
+	{
+		for(unsigned int i=0; i<lines.size(); i++)
+			queueWrite(lines[i].data(), lines[i].length());
+		requestFlush();
+		return 0;
+	}
+	if(writeGathered(lines, ec))
+	{
+		setLastError(ec);
+		return -1;
+	}
+	return 0;
+}
+
+int BoostComPort::writeGathered(const vector<string>& lines, boost::system::error_code& error)
+{
+	vector<boost::asio::const_buffer> buffers;
+	buffers.reserve(lines.size());
+	size_t length=0;
+	for(unsigned int i=0; i<lines.size(); i++)
+	{
+		buffers.push_back(boost::asio::buffer(lines[i]));
+		length+=lines[i].length();
+	}
+	if(!transport)
+		return -1;
+	size_t written=transport->write(buffers, error);
+	bytesSent+=written;
+	for(unsigned int i=0; i<lines.size(); i++)
+		consoleTap.write(lines[i].data(), lines[i].length(), true);
 	if(written!=length)
 	{
-		lastError=ec;
 		cerr<<"Failed to write all data to serial port!"<<endl;
 		return -1;
 	}
-	consoleStream.write(data, length);
 	return 0;
 }
 
@@ -136,95 +291,194 @@ int BoostComPort::read(char* data, int length, bool blocking, int timeout)
 	boost::timer time;
 	do
 	{
-		io_service.poll(); // read new data
+		poll(); // read new data
 		if(timeout>0)
 		{
-			if((int)(time.elapsed()*1000)>timeout || !serialPort.is_open())
+			if((int)(time.elapsed()*1000)>timeout || !isOpended())
 				return -1;
 		}
-	} while(blocking && currentContent<length);
-	int toCopy;
-	//cout<<"Received "<<toCopy<<" bytes"<<endl;
-	if(length<currentContent)
-		toCopy=length;
-	else
-		toCopy=currentContent;
-	memcpy(data, buffer, toCopy);
-	memcpy(buffer, buffer+toCopy, currentContent-toCopy);
-	currentContent-=toCopy;
-	return toCopy;
+	} while(blocking && (int)readBuffer->size()<length);
+	return takeFromReadBuffer(data, length);
 }
 
 /*
  * Read until a specific sequence of data
  * Reads like the read method data from the serial port by
  * polling the io service of boost.
+ * The search continues where the last call with the same
+ * searchValue stopped, already searched data is not scanned again.
  */
 int BoostComPort::readUntil(char* data, int maxLength, char* searchValue, int searchSize, bool blocking, int timeout)
 {
 	boost::timer time;
 	do
 	{
-		io_service.poll(); // read new data
+		poll(); // read new data
 		if(timeout>0)
 		{
 			if((int)(time.elapsed()*1000)>timeout)
 				return -1;
 		}
-		if(!serialPort.is_open())
+		if(!isOpended())
 			return -1;
-		for(int start=0; start<=currentContent-searchSize; start++)
+		long start=findInReadBuffer(searchValue, searchSize);
+		if(start>=0)
 		{
-			bool fits=true;
-			for(int pos=0; pos<searchSize; pos++)
-			{
-				if(buffer[start+pos]!=searchValue[pos])
-				{
-					fits=false;
-					break;
-				}
-			}
-			if(start+searchSize>=maxLength)
+			int length=start+searchSize;
+			if(length>=maxLength)
 				return -2;  // the answer will not fit in the user buffer
-			if(fits)
-			{
-				memcpy(data, buffer, start+searchSize);
-				memcpy(buffer, buffer+start+searchSize, currentContent-start-searchSize);
-				currentContent-=start+searchSize;
-				return start+searchSize;
-			}
+			return takeFromReadBuffer(data, length);
 		}
+		if((int)readBuffer->size()>=maxLength)
+			return -2;  // the answer will not fit in the user buffer
 	} while(blocking);
 	return -3;  // the searched string was not found
 }
 
+/*
+ * Read all complete lines which are available
+ * Every line ending with searchValue (including it) is appended
+ * to lines. This never blocks.
+ * Returns: The number of lines read or -1 if the port is not open
+ */
+int BoostComPort::readLines(vector<string>& lines, char* searchValue, int searchSize)
+{
+	poll();
+	if(!isOpended())
+		return -1;
+	int count=0;
+	long start;
+	while((start=findInReadBuffer(searchValue, searchSize))>=0)
+	{
+		string line(start+searchSize, 0);
+		takeFromReadBuffer(&line[0], line.length());
+		lines.push_back(line);
+		count++;
+	}
+	return count;
+}
+
+/*
+ * Read the next complete line ending with searchValue (including it)
+ * into line. The memory of line is reused, so reading the responses
+ * one by one does not allocate memory. The port is only polled if
+ * there is no complete line yet. This never blocks.
+ * Returns: The length of the line, 0 if there is no complete line, -1
+ *          if the port is closed
+ */
+int BoostComPort::readLine(string& line, char* searchValue, int searchSize)
+{
+	long start=findInReadBuffer(searchValue, searchSize);
+	if(start<0)
+	{
+		poll();
+		start=findInReadBuffer(searchValue, searchSize);
+	}
+	if(!isOpended())
+		return -1;
+	if(start<0)
+		return 0;
+	line.resize(start+searchSize);
+	takeFromReadBuffer(&line[0], line.length());
+	return line.length();
+}
+
+/*
+ * Search in the buffer read() and readUntil() work on. Data which was
+ * searched for the same searchValue before is skipped.
+ */
+long BoostComPort::findInReadBuffer(char* searchValue, int searchSize)
+{
+	if(searchedValue.compare(0, string::npos, searchValue, searchSize)!=0)
+	{
+		searchedValue.assign(searchValue, searchSize);
+		searchedUntil=0;
+	}
+	long start=readBuffer->find(searchValue, searchSize, searchedUntil);
+	if(start<0 && readBuffer->size()>=(size_t)searchSize)
+		searchedUntil=readBuffer->size()-searchSize+1;
+	return start;
+}
+
+/*
+ * Take data out of the buffer read() and readUntil() work on.
+ */
+int BoostComPort::takeFromReadBuffer(char* data, int length)
+{
+	int toCopy=readBuffer->read(data, length);
+	if(searchedUntil>(size_t)toCopy)
+		searchedUntil-=toCopy;
+	else
+		searchedUntil=0;
+	if(!ioThreadRunning)
+		startRead();  // the read may have been paused because the ring was full
+	return toCopy;
+}
+
+/*
+ * Start a new asynchronous read directly into the free space of the
+ * ring buffer. If the ring is full no read is started, the next call
+ * after data was taken out of the ring will start it again.
+ */
+void BoostComPort::startRead()
+{
+	if(readRunning || !isOpended())
+		return;
+	size_t contiguous;
+	pendingRead=buffer.writePointer(contiguous);
+	if(contiguous==0)
+		return;
+	readRunning=true;
+	transport->asyncReadSome(pendingRead, contiguous, boost::bind(&BoostComPort::onPortRead, this, _1, _2));
+}
+
 /*
  * Internal asynchronous method for read events.
  * It is "called" by the io_service.poll() call in the
- * read method.
+ * read method. The data is already in the ring buffer, it
+ * only has to be published.
  */
 void BoostComPort::onPortRead(const boost::system::error_code& error, std::size_t bytes_transferred)
 {
-	if(error==0)
+	readRunning=false;
+	if(error!=boost::asio::error::operation_aborted)
+		readEvents++;
+	if(!error)
 	{
-		memcpy(buffer+currentContent, eventBuffer, bytes_transferred);
-		currentContent+=bytes_transferred;
+		buffer.commitWrite(bytes_transferred);
+		bytesReceived+=bytes_transferred;
 		//cout<<"Received "<<bytes_transferred<<" bytes"<<endl;
-		if(streamEnabled)
+		consoleTap.write(pendingRead, bytes_transferred, false);
+		if(ioThreadRunning)
 		{
-			consoleStream.write(eventBuffer, bytes_transferred);
-			if(consoleStream.bad())
-				cout<<"ConsoleStream is bad!"<<endl;
+			dispatchReceived();  // also starts the next read
+			executed=true;
+			return;
 		}
 	}
-	else if(error!=boost::asio::error::operation_aborted)  // not cancelled
+	else if(error==boost::asio::error::operation_aborted)  // cancelled, the port is closed
+	{
+		executed=true;
+		return;
+	}
+	else if(error==boost::asio::error::eof || error==boost::system::errc::io_error)
+	{
+		// the other side closed the connection or the device is gone,
+		// no read is started again and isOpended() returns false
+		cerr<<"BoostComPort::onPortRead(): Connection closed by the other side"<<endl;
+		setLastError(error);
+		connectionLost=true;
+		executed=true;
+		return;
+	}
+	else
 	{
 		cerr<<"BoostComPort::onPortRead(): Unable to read from com port with error: "<<endl;
 		cerr<<"BoostComPort::onPortRead():   Error message: "<<error.message()<<endl;
 		cerr<<"BoostComPort::onPortRead():   Error code: "<<error<<endl;
-		lastError=ec;
+		setLastError(error);
 	}
-	serialPort.async_read_some(boost::asio::buffer(eventBuffer, EVENTBUFFER_SIZE), boost::bind(&BoostComPort::onPortRead, this, _1, _2));
+	startRead();
 	executed=true;
 }
 
@@ -236,22 +490,322 @@ void BoostComPort::onPortRead(const boost::system::error_code& error, std::size_
  */
 void BoostComPort::poll()
 {
-	io_service.poll();
+	if(ioThreadRunning)
+		receiveQueued();
+	else if(&io_service==&ownService)  // a shared io_service is polled by its owner
+		io_service.poll();
+}
+
+/*
+ * Returns: The number of bytes written to the port since it was created
+ */
+boost::uint64_t BoostComPort::getBytesSent()
+{
+	return bytesSent;
+}
+
+/*
+ * Returns: The number of bytes received since the port was created
+ */
+boost::uint64_t BoostComPort::getBytesReceived()
+{
+	return bytesReceived;
+}
+
+/*
+ * Count the completed reads without I/O thread, so the owner of a
+ * shared io_service can tell which ports received data or lost their
+ * connection after running it.
+ * Returns: The number of reads which completed with data or an error
+ *          since the port was created
+ */
+long BoostComPort::getReadEvents()
+{
+	return readEvents;
+}
+
+/*
+ * Returns: The baud rate the port was opened with
+ */
+int BoostComPort::getBaud()
+{
+	return baud;
+}
+
+/*
+ * Returns: The number of received bytes which are not read yet
+ */
+int BoostComPort::available()
+{
+	return readBuffer->size();
 }
 
 void BoostComPort::clearBuffers()
 {
-	currentContent=0;
+	if(ioThreadRunning)
+	{
+		char discarded[256];
+		while(rxQueue->pop(discarded, sizeof(discarded)));
+		lineBuffer->consume(lineBuffer->size());
+		searchedUntil=0;
+		if(rxStalled.exchange(false))
+			io_service.post(boost::bind(&BoostComPort::dispatchReceived, this));
+		return;
+	}
+	buffer.consume(buffer.size());
+	searchedUntil=0;
+	startRead();
+}
+
+/*
+ * Enable or disable the I/O thread.
+ * With the I/O thread the serial port is serviced independent of
+ * how often poll() or one of the read methods is called, so a busy
+ * caller does not stall the communication. If realtimePriority is
+ * greater than 0 the thread is started with this real-time priority
+ * (SCHED_FIFO, needs the according permissions on Linux).
+ * The setting takes effect the next time the port is opened.
+ */
+void BoostComPort::setIoThreadEnabled(bool enable, int realtimePriority)
+{
+	ioThreadEnabled=enable;
+	ioThreadPriority=realtimePriority;
+}
+
+bool BoostComPort::isIoThreadEnabled()
+{
+	return ioThreadEnabled;
+}
+
+/*
+ * Set a handler the I/O thread calls after it handed over received
+ * data, so the reader can answer at once instead of at its next
+ * poll(). The handler may read and write the port, the caller has to
+ * make sure that no other thread does so at the same time. If it
+ * returns false (the reader is busy) it is called again after
+ * RECEIVE_RETRY milliseconds. Set it before the port is opened.
+ */
+void BoostComPort::setReceiveHandler(ReceiveHandler handler)
+{
+	receiveHandler=handler;
+}
+
+void BoostComPort::startIoThread()
+{
+	if(ioThreadRunning)
+		return;
+	if(!lineBuffer)
+	{
+		// only ports with an I/O thread need these
+		lineBuffer=new RingBuffer(LINEBUFFER_SIZE);
+		rxQueue=new ByteQueue(QUEUE_SIZE);
+		txQueue=new ByteQueue(QUEUE_SIZE);
+		txData.resize(QUEUE_SIZE);
+		receiveRetry=new boost::asio::deadline_timer(io_service);
+	}
+	lineBuffer->clear();
+	readBuffer=lineBuffer;
+	searchedUntil=0;
+	rxStalled=false;
+	ioThreadRunning=true;
+	io_service.reset();
+	ioWork=new boost::asio::io_service::work(io_service);
+	io_service.post(boost::bind(&BoostComPort::dispatchReceived, this));  // hand over what is already received
+	{
+		boost::mutex::scoped_lock lock(txMutex);  // runIoThread() waits until ioThreadId is set
+		ioThread=new boost::thread(boost::bind(&BoostComPort::runIoThread, this));
+		ioThreadId=ioThread->get_id();
+	}
+	if(ioThreadPriority>0)
+	{
+#ifdef _WIN32
+		if(!SetThreadPriority(ioThread->native_handle(), THREAD_PRIORITY_TIME_CRITICAL))
+			cerr<<"BoostComPort::startIoThread(): Unable to set the priority of the I/O thread"<<endl;
+#else
+		sched_param param;
+		param.sched_priority=ioThreadPriority;
+		int result=pthread_setschedparam(ioThread->native_handle(), SCHED_FIFO, &param);
+		if(result!=0)
+			cerr<<"BoostComPort::startIoThread(): Unable to set real-time priority "<<ioThreadPriority<<": "<<strerror(result)<<endl;
+#endif
+	}
+}
+
+/*
+ * Stop the I/O thread. Data which is still queued for writing is
+ * written before, received data which was not read yet is lost.
+ */
+void BoostComPort::stopIoThread()
+{
+	if(!ioThreadRunning)
+		return;
+	delete ioWork;
+	ioWork=NULL;
+	io_service.stop();
+	ioThread->join();
+	delete ioThread;
+	ioThread=NULL;
+	ioThreadId=boost::thread::id();
+	receiveRetry->cancel();
+	io_service.reset();
+	ioThreadRunning=false;
+	readBuffer=&buffer;
+	searchedUntil=0;
+	flushWrites();
+	rxQueue->reset();
+	lineBuffer->clear();
+}
+
+void BoostComPort::runIoThread()
+{
+	{
+		boost::mutex::scoped_lock lock(txMutex);
+	}
+	try
+	{
+		io_service.run();
+	}
+	catch(std::exception& e)
+	{
+		cerr<<"BoostComPort::runIoThread(): I/O thread stopped with exception: "<<e.what()<<endl;
+	}
+}
+
+/*
+ * Runs in the I/O thread.
+ * Moves the received data from the ring to rxQueue and calls the
+ * receive handler. If the queue is full the rest stays in the ring and
+ * the reading thread will trigger this method again after it took
+ * some data.
+ */
+void BoostComPort::dispatchReceived()
+{
+	bool dispatched=false;
+	while(!buffer.isEmpty())
+	{
+		size_t contiguous;
+		const char* data=buffer.readPointer(0, contiguous);
+		size_t queued=rxQueue->push(data, contiguous);
+		if(queued==0)
+		{
+			rxStalled=true;
+			queued=rxQueue->push(data, contiguous);  // the reader may have taken data in the meantime
+			if(queued==0)
+				break;
+		}
+		buffer.consume(queued);
+		dispatched=true;
+	}
+	startRead();
+	if(dispatched)
+		callReceiveHandler();
+}
+
+/*
+ * Runs in the I/O thread.
+ */
+void BoostComPort::callReceiveHandler()
+{
+	if(!receiveHandler || receiveHandler())
+		return;
+	receiveRetry->expires_from_now(boost::posix_time::milliseconds(RECEIVE_RETRY));
+	receiveRetry->async_wait(boost::bind(&BoostComPort::onReceiveRetry, this, boost::asio::placeholders::error));
 }
 
-iostream& BoostComPort::enableStream()
+void BoostComPort::onReceiveRetry(const boost::system::error_code& error)
+{
+	if(!error)
+		callReceiveHandler();
+}
+
+/*
+ * Hand data to the I/O thread without allocating memory. If txQueue
+ * is full the thread writes it out first, the caller waits for it.
+ * Called by the I/O thread itself (from the receive handler) the
+ * queue is written out directly.
+ */
+void BoostComPort::queueWrite(const char* data, size_t length)
+{
+	bool inIoThread=boost::this_thread::get_id()==ioThreadId;
+	while(true)
+	{
+		size_t queued=txQueue->push(data, length);
+		data+=queued;
+		length-=queued;
+		if(length==0)
+			return;
+		if(inIoThread)
+		{
+			flushWrites();
+			continue;
+		}
+		boost::mutex::scoped_lock lock(txMutex);
+		io_service.post(boost::bind(&BoostComPort::flushWrites, this));
+		while(!txQueue->write_available())
+			txSpace.wait(lock);
+	}
+}
+
+/*
+ * Let the I/O thread write what is queued, at once if it calls this.
+ */
+void BoostComPort::requestFlush()
+{
+	if(boost::this_thread::get_id()==ioThreadId)
+		flushWrites();
+	else
+		io_service.post(boost::bind(&BoostComPort::flushWrites, this));
+}
+
+/*
+ * Runs in the I/O thread.
+ * Writes all data which is queued in txQueue.
+ */
+void BoostComPort::flushWrites()
+{
+	size_t length=txQueue->pop(&txData[0], txData.size());
+	if(length==0)
+		return;
+	{
+		boost::mutex::scoped_lock lock(txMutex);
+	}
+	txSpace.notify_all();
+	boost::system::error_code writeError;
+	if(writeData(&txData[0], length, writeError))
+		setLastError(writeError);
+}
+
+/*
+ * Takes the data the I/O thread has received out of rxQueue and
+ * appends it to lineBuffer which is used by read() and readUntil().
+ */
+void BoostComPort::receiveQueued()
+{
+	while(true)
+	{
+		size_t contiguous;
+		char* data=lineBuffer->writePointer(contiguous);
+		size_t received=contiguous>0 ? rxQueue->pop(data, contiguous) : 0;
+		if(received==0)
+			break;
+		lineBuffer->commitWrite(received);
+	}
+	if(rxStalled.exchange(false))
+		io_service.post(boost::bind(&BoostComPort::dispatchReceived, this));
+}
+
+/*
+ * Start recording all sent and received data in the console tap.
+ * Returns: The tap to read the data from
+ */
+ConsoleTap& BoostComPort::enableConsoleTap()
 {
-	streamEnabled=true;
-	return consoleStream;
+	consoleTap.setEnabled(true);
+	return consoleTap;
 }
 
-void BoostComPort::disableStream()
+void BoostComPort::disableConsoleTap()
 {
-	streamEnabled=false;
+	consoleTap.setEnabled(false);
 }
 
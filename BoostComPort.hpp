@@ -23,57 +23,134 @@ along with BoostComPort.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <boost/asio.hpp>
 #include <string>
+#include <vector>
 #include <iostream>
 #include <boost/timer.hpp>
+#include <boost/thread.hpp>
+#include <boost/function.hpp>
+#include <boost/atomic.hpp>
+#include <boost/lockfree/spsc_queue.hpp>
+#include "RingBuffer.hpp"
+#include "ConsoleTap.hpp"
+#include "Transport.hpp"
 
 #include <iostream>
 #include <sstream>
 
 #define BUFFER_SIZE 1000000
-#define EVENTBUFFER_SIZE 1000000
+#define LINEBUFFER_SIZE 65536  // receive buffer of the reading thread when the I/O thread is used
+#define QUEUE_SIZE 65536  // bytes in each queue between the I/O thread and the other thread
+#define RECEIVE_RETRY 1  // milliseconds until the receive handler is called again if it was busy
 
 using namespace std;
 
+typedef boost::lockfree::spsc_queue<char> ByteQueue;
+typedef boost::function<bool ()> ReceiveHandler;
+
 /*
  * BoostComPort is a simple and small class providing access
- * to the computers com ports (serial ports).
+ * to the computers com ports (serial ports). Other byte streams
+ * like TCP connections are supported by the Transport classes.
  * Hardware and software flow control are not supported yet.
  * Non standard baud rates are supported (useable for example
  * with the FTDI FT232 chip).
+ * Optionally the port can be serviced by its own I/O thread (see
+ * setIoThreadEnabled()). Received data and data to write are then
+ * handed over through lock-free single producer single consumer byte
+ * queues, so all other methods must be called from one thread at a
+ * time. A receive handler (see setReceiveHandler()) lets the I/O
+ * thread answer received lines at once, it may read and write then.
+ * Instead many ports can share one io_service without I/O threads,
+ * see the constructor.
  */
 class BoostComPort
 {
 public:
-	BoostComPort();
+	BoostComPort(boost::asio::io_service* sharedService=NULL, size_t bufferSize=BUFFER_SIZE);
 	~BoostComPort();
 	int open(std::string port, int baud);
 	int close();
 	bool isOpended();
+	string getName();
+	int getNativeHandle();
 	int write(char* Data, unsigned int Length);
+	int writeLines(const vector<string>& lines);
 	int read(char* data, int length, bool blocking=false, int timeout=-1 /* timeout in ms */);
 	int readUntil(char* data, int maxLength, char* searchValue, int searchSize, bool blocking=false, int timeout=-1);
+	int readLines(vector<string>& lines, char* searchValue=(char*)"\n", int searchSize=1);
+	int readLine(string& line, char* searchValue=(char*)"\n", int searchSize=1);
 	void poll();
+	int available();
+	boost::uint64_t getBytesSent();
+	boost::uint64_t getBytesReceived();
+	long getReadEvents();
+	int getBaud();
 	void clearBuffers();
-	boost::system::error_code& getLastError();
+	boost::system::error_code getLastError();
+	
+	void setIoThreadEnabled(bool enable, int realtimePriority=0);
+	bool isIoThreadEnabled();
+	void setReceiveHandler(ReceiveHandler handler);
 	
-	iostream& enableStream();
-	void disableStream();
+	ConsoleTap& enableConsoleTap();
+	void disableConsoleTap();
 
 private:
+	void startRead();
 	void onPortRead(const boost::system::error_code& error, std::size_t bytes_transferred);
+	long findInReadBuffer(char* searchValue, int searchSize);
+	int takeFromReadBuffer(char* data, int length);
+	void startIoThread();
+	void stopIoThread();
+	void runIoThread();
+	void dispatchReceived();
+	void callReceiveHandler();
+	void onReceiveRetry(const boost::system::error_code& error);
+	void queueWrite(const char* data, size_t length);
+	void requestFlush();
+	void flushWrites();
+	int writeData(const char* data, size_t length, boost::system::error_code& error);
+	int writeGathered(const vector<string>& lines, boost::system::error_code& error);
+	void receiveQueued();
+	void setLastError(const boost::system::error_code& error);
 
-	char* buffer;
-	char* eventBuffer;
-	int currentContent;
+	RingBuffer buffer;
+	RingBuffer* lineBuffer;  // data taken from rxQueue, only created for the I/O thread
+	RingBuffer* readBuffer;  // the buffer read() and readUntil() work on
+	string searchedValue;  // last searchValue of readUntil()
+	size_t searchedUntil;  // readBuffer is searched for searchedValue up to here
+	char* pendingRead;  // position in the ring the running asynchronous read writes to
+	bool readRunning;
 	bool executed;
-	boost::asio::io_service io_service;
-	boost::asio::serial_port serialPort;
+	boost::asio::io_service ownService;  // used if no io_service is shared
+	boost::asio::io_service& io_service;
+	Transport* transport;
+	boost::atomic<bool> connectionLost;  // the other side closed the connection, the transport is not usable any more
+	boost::atomic<boost::uint64_t> bytesSent;
+	boost::atomic<boost::uint64_t> bytesReceived;
+	long readEvents;  // completed reads with data or an error, see getReadEvents()
+	int baud;  // of the last open()
 	boost::system::error_code ec;
 	boost::system::error_code lastError;
+	boost::mutex errorMutex;  // lastError is set by the I/O thread as well
+	
+	// I/O thread
+	bool ioThreadEnabled;
+	int ioThreadPriority;
+	bool ioThreadRunning;
+	boost::thread* ioThread;
+	boost::thread::id ioThreadId;
+	boost::asio::io_service::work* ioWork;
+	ByteQueue* rxQueue;
+	ByteQueue* txQueue;
+	vector<char> txData;  // taken out of txQueue to be written, only used by the I/O thread
+	boost::mutex txMutex;
+	boost::condition_variable txSpace;  // notified by the I/O thread when it took data out of txQueue
+	boost::atomic<bool> rxStalled;  // the I/O thread waits for space in rxQueue
+	ReceiveHandler receiveHandler;
+	boost::asio::deadline_timer* receiveRetry;
 	
-	stringbuf consoleStreamBuffer;
-	iostream consoleStream;
-	bool streamEnabled;
+	ConsoleTap consoleTap;
 protected:
 
 };
@@ -0,0 +1,227 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CommandQueue.hpp"
+
+#define INITIAL_RING_SIZE 64
+
+CommandQueue::CommandQueue():
+ring(INITIAL_RING_SIZE, 0),
+head(0),
+count(0),
+queued(0)
+{
+
+}
+
+/*
+ * Add a command at the end of the queue. The id of the command is
+ * set by the queue.
+ * Returns: The id of the queued command
+ */
+CommandId CommandQueue::pushBack(const Command& command)
+{
+	if(count==ring.size())
+		grow();
+	CommandId id=allocate(command);
+	ring[(head+count) & (ring.size()-1)]=id;
+	count++;
+	return id;
+}
+
+/*
+ * Add a command in front of all other commands.
+ * Returns: The id of the queued command
+ */
+CommandId CommandQueue::pushFront(const Command& command)
+{
+	if(count==ring.size())
+		grow();
+	CommandId id=allocate(command);
+	head=(head-1) & (ring.size()-1);
+	ring[head]=id;
+	count++;
+	return id;
+}
+
+/*
+ * Get the first command. The queue must not be empty.
+ */
+Command& CommandQueue::front()
+{
+	skipCancelled();
+	return slotOf(ring[head])->command;
+}
+
+void CommandQueue::popFront()
+{
+	skipCancelled();
+	if(count==0)
+		return;
+	release(ring[head] & 0xffffffff);
+	head=(head+1) & (ring.size()-1);
+	count--;
+}
+
+size_t CommandQueue::size() const
+{
+	return queued;
+}
+
+bool CommandQueue::empty() const
+{
+	return queued==0;
+}
+
+/*
+ * Remove all commands. The slots are kept, so ids handed out before
+ * never match a command queued later.
+ */
+void CommandQueue::clear()
+{
+	for(size_t i=0; i<slots.size(); i++)
+		release(i);
+	ring.assign(INITIAL_RING_SIZE, 0);
+	head=0;
+	count=0;
+	queued=0;
+}
+
+/*
+ * The command stays at its address until it is removed from the queue,
+ * adding other commands does not move it.
+ * Returns: The queued command with the given id, NULL if it has been
+ *          sent or cancelled already
+ */
+Command* CommandQueue::find(CommandId id)
+{
+	Slot* slot=slotOf(id);
+	if(slot==NULL)
+		return NULL;
+	return &slot->command;
+}
+
+/*
+ * Remove a command from the queue without sending it.
+ * Returns: false if the command is not queued any more
+ */
+bool CommandQueue::cancel(CommandId id)
+{
+	if(slotOf(id)==NULL)
+		return false;
+	release(id & 0xffffffff);
+	return true;
+}
+
+/*
+ * Number of positions for entry(), cancelled commands included.
+ */
+size_t CommandQueue::entries() const
+{
+	return count;
+}
+
+/*
+ * Get the command at a position of the queue, counted from the front.
+ * Returns: The command or NULL if it was cancelled
+ */
+Command* CommandQueue::entry(size_t position)
+{
+	if(position>=count)
+		return NULL;
+	return find(ring[(head+position) & (ring.size()-1)]);
+}
+
+/*
+ * Put a command into a free slot.
+ * Returns: The id of the slot, the generation in the upper and the
+ *          index of the slot in the lower 32 bits
+ */
+CommandId CommandQueue::allocate(const Command& command)
+{
+	size_t index;
+	if(freeSlots.empty())
+	{
+		index=slots.size();
+		Slot slot;
+		slot.command=command;
+		slot.generation=1;
+		slot.queued=false;
+		slots.push_back(slot);
+	}
+	else
+	{
+		index=freeSlots.back();
+		freeSlots.pop_back();
+		slots[index].command=command;
+	}
+	Slot& slot=slots[index];
+	CommandId id=((CommandId)slot.generation<<32) | index;
+	slot.command.id=id;
+	slot.queued=true;
+	queued++;
+	return id;
+}
+
+void CommandQueue::release(size_t index)
+{
+	Slot& slot=slots[index];
+	if(!slot.queued)
+		return;
+	slot.queued=false;
+	slot.command.command=string();  // give the memory of long lines back
+	slot.generation++;
+	if(slot.generation==0)
+		slot.generation=1;
+	freeSlots.push_back(index);
+	queued--;
+}
+
+/*
+ * Double the size of the ring, the ids keep their order.
+ */
+void CommandQueue::grow()
+{
+	vector<CommandId> larger(ring.size()*2, 0);
+	for(size_t i=0; i<count; i++)
+		larger[i]=ring[(head+i) & (ring.size()-1)];
+	ring.swap(larger);
+	head=0;
+}
+
+/*
+ * Drop the ids of cancelled commands from the front of the ring.
+ */
+void CommandQueue::skipCancelled()
+{
+	while(count>0 && slotOf(ring[head])==NULL)
+	{
+		head=(head+1) & (ring.size()-1);
+		count--;
+	}
+}
+
+CommandQueue::Slot* CommandQueue::slotOf(CommandId id)
+{
+	size_t index=id & 0xffffffff;
+	if(index>=slots.size())
+		return NULL;
+	Slot& slot=slots[index];
+	if(!slot.queued || slot.generation!=(id>>32))
+		return NULL;
+	return &slot;
+}
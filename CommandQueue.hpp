@@ -0,0 +1,95 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef COMMANDQUEUE_HPP_
+#define COMMANDQUEUE_HPP_
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <boost/cstdint.hpp>
+
+using namespace std;
+
+typedef boost::uint64_t CommandId;  // 0 is never a valid id
+
+struct Command
+{
+	CommandId id;
+	string command;
+	double time;
+	double jobTime;  // calculated time of the job before this command, -1.0 if it is not part of a job
+	int m;
+	int g;
+	double x, y, z, f;
+	boost::int64_t queued;  // time it was queued, see LinkStatistics::getTime()
+};
+
+/*
+ * CommandQueue is the queue of commands waiting to be sent by the
+ * RepRapHost class. Adding at both ends and removing the first command
+ * take constant time, independent of the length of the queue.
+ * Every queued command gets an id which stays valid until the command
+ * is removed, so callers can look it up or cancel it later. The
+ * commands are kept in slots in a deque, which does not move them when
+ * it grows, the queue order is a ring of ids. A command returned by
+ * find() stays valid until it is removed, then its slot is used for
+ * another command. A cancelled command leaves its id in the ring, it
+ * is skipped when it reaches the front.
+ */
+class CommandQueue
+{
+public:
+	CommandQueue();
+
+	CommandId pushBack(const Command& command);
+	CommandId pushFront(const Command& command);
+	Command& front();
+	void popFront();
+	size_t size() const;
+	bool empty() const;
+	void clear();
+
+	Command* find(CommandId id);
+	bool cancel(CommandId id);
+
+	size_t entries() const;
+	Command* entry(size_t position);
+
+private:
+	struct Slot
+	{
+		Command command;
+		boost::uint32_t generation;  // incremented every time the slot is freed
+		bool queued;
+	};
+
+	CommandId allocate(const Command& command);
+	void release(size_t index);
+	void grow();
+	void skipCancelled();
+	Slot* slotOf(CommandId id);
+
+	deque<Slot> slots;  // never moved, see find()
+	vector<size_t> freeSlots;
+	vector<CommandId> ring;  // the size is always a power of two
+	size_t head;
+	size_t count;  // ids in the ring including cancelled ones
+	size_t queued;  // commands in the queue
+};
+
+#endif /* COMMANDQUEUE_HPP_ */
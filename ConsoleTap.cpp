@@ -0,0 +1,156 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ConsoleTap.hpp"
+#include <cstring>
+
+ConsoleTap::ConsoleTap():
+nextSequence(0),
+enabled(false),
+created(boost::chrono::steady_clock::now())
+{
+	slots=new Slot[CONSOLETAP_RECORDS];
+	for(int i=0; i<CONSOLETAP_RECORDS; i++)
+		slots[i].stamp.store(0, boost::memory_order_relaxed);
+}
+
+ConsoleTap::~ConsoleTap()
+{
+	delete[] slots;
+}
+
+/*
+ * Data is only recorded while the tap is enabled.
+ */
+void ConsoleTap::setEnabled(bool enable)
+{
+	enabled=enable;
+}
+
+bool ConsoleTap::isEnabled()
+{
+	return enabled;
+}
+
+/*
+ * Record data, split into as many records as needed.
+ * Every record gets its own sequence number, the slot is marked as
+ * being written (odd stamp) while the data is copied, so a reader
+ * never takes a half written record.
+ */
+void ConsoleTap::write(const char* data, size_t length, bool transmitted)
+{
+	if(!enabled)
+		return;
+	boost::uint64_t time=boost::chrono::duration_cast<boost::chrono::microseconds>(boost::chrono::steady_clock::now()-created).count();
+	size_t written=0;
+	while(written<length)
+	{
+		size_t recordLength=length-written;
+		if(recordLength>CONSOLETAP_RECORD_SIZE)
+			recordLength=CONSOLETAP_RECORD_SIZE;
+		boost::uint64_t sequence=nextSequence.fetch_add(1, boost::memory_order_relaxed);
+		Slot& slot=slots[sequence%CONSOLETAP_RECORDS];
+		slot.stamp.store(2*sequence+1, boost::memory_order_relaxed);
+		boost::atomic_thread_fence(boost::memory_order_release);
+		slot.record.sequence=sequence;
+		slot.record.time=time;
+		slot.record.transmitted=transmitted;
+		slot.record.length=recordLength;
+		memcpy(slot.record.data, data+written, recordLength);
+		slot.stamp.store(2*sequence+2, boost::memory_order_release);
+		written+=recordLength;
+	}
+}
+
+/*
+ * Returns: The sequence number the next record will get
+ */
+boost::uint64_t ConsoleTap::head()
+{
+	return nextSequence.load(boost::memory_order_acquire);
+}
+
+/*
+ * Returns: The position to start reading the last records records
+ */
+boost::uint64_t ConsoleTap::tail(size_t records)
+{
+	boost::uint64_t end=head();
+	if(records>end)
+		return 0;
+	return end-records;
+}
+
+/*
+ * Returns: The number of records which were overwritten because the tap
+ *          was full, readers may have read some of them before
+ */
+boost::uint64_t ConsoleTap::overwritten()
+{
+	boost::uint64_t end=head();
+	if(end<CONSOLETAP_RECORDS)
+		return 0;
+	return end-CONSOLETAP_RECORDS;
+}
+
+/*
+ * Append all complete records from position on to records and move
+ * position behind them. Records which were overwritten before they
+ * could be read are skipped and added to lost.
+ * Returns: The number of records appended
+ */
+size_t ConsoleTap::drain(boost::uint64_t& position, vector<ConsoleRecord>& records, boost::uint64_t& lost)
+{
+	size_t count=0;
+	boost::uint64_t end=head();
+	ConsoleRecord record;
+	while(position<end)
+	{
+		if(end-position>CONSOLETAP_RECORDS)
+		{
+			lost+=end-position-CONSOLETAP_RECORDS;
+			position=end-CONSOLETAP_RECORDS;
+		}
+		if(readRecord(position, record))
+		{
+			records.push_back(record);
+			count++;
+		}
+		else if(slots[position%CONSOLETAP_RECORDS].stamp.load(boost::memory_order_acquire)<2*position+2)
+		{
+			break;  // still being written, try again next time
+		}
+		else
+		{
+			lost++;  // overwritten while it was read
+		}
+		position++;
+	}
+	return count;
+}
+
+bool ConsoleTap::readRecord(boost::uint64_t sequence, ConsoleRecord& record)
+{
+	Slot& slot=slots[sequence%CONSOLETAP_RECORDS];
+	boost::uint64_t stamp=slot.stamp.load(boost::memory_order_acquire);
+	if(stamp!=2*sequence+2)
+		return false;
+	record=slot.record;
+	boost::atomic_thread_fence(boost::memory_order_acquire);
+	return slot.stamp.load(boost::memory_order_relaxed)==stamp;
+}
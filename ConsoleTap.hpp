@@ -0,0 +1,84 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONSOLETAP_HPP_
+#define CONSOLETAP_HPP_
+
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/chrono.hpp>
+
+#define CONSOLETAP_RECORDS 4096
+#define CONSOLETAP_RECORD_SIZE 112  // longer data is split into several records
+
+using namespace std;
+
+struct ConsoleRecord
+{
+	boost::uint64_t sequence;
+	boost::uint64_t time;  // microseconds since the tap was created
+	bool transmitted;  // true for data sent to the port, false for received data
+	unsigned short length;
+	char data[CONSOLETAP_RECORD_SIZE];
+};
+
+/*
+ * ConsoleTap records all data sent and received by the BoostComPort
+ * class in a fixed number of records, for example to show it in a
+ * terminal window.
+ * Writing never blocks and never allocates memory, it may be done from
+ * several threads at the same time. When the tap is full the oldest
+ * records are overwritten. Readers keep their own position (a sequence
+ * number) and can start reading at any record still in the tap; they
+ * are told how many records they lost because they were overwritten.
+ */
+class ConsoleTap
+{
+public:
+	ConsoleTap();
+	~ConsoleTap();
+
+	void setEnabled(bool enable);
+	bool isEnabled();
+
+	void write(const char* data, size_t length, bool transmitted);
+
+	boost::uint64_t head();
+	boost::uint64_t tail(size_t records);
+	boost::uint64_t overwritten();
+	size_t drain(boost::uint64_t& position, vector<ConsoleRecord>& records, boost::uint64_t& lost);
+
+private:
+	ConsoleTap(const ConsoleTap&);
+	ConsoleTap& operator=(const ConsoleTap&);
+
+	struct Slot
+	{
+		boost::atomic<boost::uint64_t> stamp;  // 2*sequence+1 while written, 2*sequence+2 when complete
+		ConsoleRecord record;
+	};
+
+	bool readRecord(boost::uint64_t sequence, ConsoleRecord& record);
+
+	Slot* slots;
+	boost::atomic<boost::uint64_t> nextSequence;
+	boost::atomic<bool> enabled;
+	boost::chrono::steady_clock::time_point created;
+};
+
+#endif /* CONSOLETAP_HPP_ */
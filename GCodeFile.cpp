@@ -0,0 +1,208 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "GCodeFile.hpp"
+#include <iostream>
+#include <fstream>
+#include <cstring>
+
+using namespace boost::interprocess;
+
+GCodeFile::GCodeFile():
+mapping(NULL),
+region(NULL),
+fileSize(0),
+windowStart(0),
+position(0),
+linesRead(0)
+{
+
+}
+
+GCodeFile::~GCodeFile()
+{
+	close();
+}
+
+/*
+ * Open a G-code file, a file opened before is closed.
+ * Returns: 0 on success
+ */
+int GCodeFile::open(string fileName)
+{
+	close();
+	ifstream file(fileName.c_str(), ios::in | ios::binary | ios::ate);
+	if(!file.is_open())
+	{
+		cerr<<"GCodeFile::open(): Unable to open "<<fileName<<endl;
+		return -1;
+	}
+	fileSize=file.tellg();
+	file.close();
+	if(fileSize==0)
+		return 0;  // nothing to map
+	try
+	{
+		mapping=new file_mapping(fileName.c_str(), read_only);
+	}
+	catch(interprocess_exception& e)
+	{
+		cerr<<"GCodeFile::open(): Unable to map "<<fileName<<": "<<e.what()<<endl;
+		fileSize=0;
+		return -1;
+	}
+	return mapWindow(0);
+}
+
+void GCodeFile::close()
+{
+	delete region;
+	region=NULL;
+	delete mapping;
+	mapping=NULL;
+	fileSize=0;
+	windowStart=0;
+	position=0;
+	linesRead=0;
+}
+
+bool GCodeFile::isOpen()
+{
+	return mapping!=NULL;
+}
+
+bool GCodeFile::atEnd()
+{
+	return position>=fileSize;
+}
+
+/*
+ * Get the next command of the file without comment and whitespace.
+ * Returns: false at the end of the file
+ */
+bool GCodeFile::readLine(string& line)
+{
+	bool remapped=false;
+	while(position<fileSize)
+	{
+		boost::uint64_t windowEnd=windowStart+region->get_size();
+		if(position<windowStart || position>=windowEnd)
+		{
+			if(mapWindow(position))
+				return false;
+			windowEnd=windowStart+region->get_size();
+		}
+		const char* begin=(const char*)region->get_address()+(position-windowStart);
+		size_t available=windowEnd-position;
+		const char* end=(const char*)memchr(begin, '\n', available);
+		if(end==NULL && windowEnd<fileSize && !remapped)
+		{
+			// the line continues behind the window, map the next one from here
+			if(mapWindow(position))
+				return false;
+			remapped=true;
+			continue;
+		}
+		if(end==NULL)
+			end=begin+available;  // last line without line end or longer than a window
+		remapped=false;
+		position+=end-begin+1;
+		if(position>fileSize)
+			position=fileSize;
+		if(stripLine(begin, end, line))
+		{
+			linesRead++;
+			return true;
+		}
+	}
+	return false;
+}
+
+boost::uint64_t GCodeFile::getSize()
+{
+	return fileSize;
+}
+
+/*
+ * Returns: The number of bytes read so far
+ */
+boost::uint64_t GCodeFile::getPosition()
+{
+	return position;
+}
+
+long GCodeFile::getLinesRead()
+{
+	return linesRead;
+}
+
+/*
+ * Map the window which contains the given file offset. The start of
+ * the window is aligned to the page size.
+ */
+int GCodeFile::mapWindow(boost::uint64_t offset)
+{
+	boost::uint64_t pageSize=mapped_region::get_page_size();
+	boost::uint64_t start=offset-offset%pageSize;
+	boost::uint64_t size=fileSize-start;
+	if(size>GCODEFILE_WINDOW_SIZE)
+		size=GCODEFILE_WINDOW_SIZE;
+	delete region;
+	region=NULL;
+	try
+	{
+		region=new mapped_region(*mapping, read_only, start, size);
+	}
+	catch(interprocess_exception& e)
+	{
+		cerr<<"GCodeFile::mapWindow(): Unable to map the file: "<<e.what()<<endl;
+		position=fileSize;
+		return -1;
+	}
+	region->advise(mapped_region::advice_sequential);
+	windowStart=start;
+	return 0;
+}
+
+/*
+ * Remove the comment and surrounding whitespace of a line by moving
+ * begin and end, the line is not changed.
+ * Returns: false if nothing is left
+ */
+bool GCodeFile::trimLine(const char*& begin, const char*& end)
+{
+	const char* comment=(const char*)memchr(begin, ';', end-begin);
+	if(comment)
+		end=comment;
+	while(begin<end && (*begin==' ' || *begin=='\t' || *begin=='\r'))
+		begin++;
+	while(end>begin && (end[-1]==' ' || end[-1]=='\t' || end[-1]=='\r'))
+		end--;
+	return begin<end;
+}
+
+/*
+ * Copy a line without comment and surrounding whitespace.
+ * Returns: false if nothing is left
+ */
+bool GCodeFile::stripLine(const char* begin, const char* end, string& line)
+{
+	if(!trimLine(begin, end))
+		return false;
+	line.assign(begin, end-begin);
+	return true;
+}
@@ -0,0 +1,70 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GCODEFILE_HPP_
+#define GCODEFILE_HPP_
+
+#include <string>
+#include <boost/cstdint.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#define GCODEFILE_WINDOW_SIZE (16*1024*1024)  // bytes of the file mapped at once
+
+using namespace std;
+
+/*
+ * GCodeFile reads the commands of a G-code file one by one without
+ * loading the whole file. The file is memory mapped in windows of
+ * GCODEFILE_WINDOW_SIZE bytes, so the memory used does not depend on
+ * the size of the file. Comments (after ';') and surrounding
+ * whitespace are removed on the mapped bytes, empty lines are skipped.
+ */
+class GCodeFile
+{
+public:
+	GCodeFile();
+	~GCodeFile();
+
+	int open(string fileName);
+	void close();
+	bool isOpen();
+	bool atEnd();
+	bool readLine(string& line);
+
+	boost::uint64_t getSize();
+	boost::uint64_t getPosition();
+	long getLinesRead();
+
+	static bool trimLine(const char*& begin, const char*& end);
+
+private:
+	GCodeFile(const GCodeFile&);
+	GCodeFile& operator=(const GCodeFile&);
+
+	int mapWindow(boost::uint64_t offset);
+	static bool stripLine(const char* begin, const char* end, string& line);
+
+	boost::interprocess::file_mapping* mapping;
+	boost::interprocess::mapped_region* region;
+	boost::uint64_t fileSize;
+	boost::uint64_t windowStart;  // file offset of the mapped window
+	boost::uint64_t position;  // file offset of the next line
+	long linesRead;
+};
+
+#endif /* GCODEFILE_HPP_ */
@@ -0,0 +1,444 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "GCodeParser.hpp"
+#include "GCodeTokenizer.hpp"
+#include "BinaryGCode.hpp"
+#include <iostream>
+#include <cmath>
+
+GCodeParser::GCodeParser():
+debug(false),
+lastX(0.0),
+lastY(0.0),
+lastZ(0.0),
+lastF(0.0),
+lastE(0.0),
+relative(false),
+relativeE(false),
+feedrateWarned(false)
+{
+
+}
+
+void GCodeParser::setDebug(bool debug)
+{
+	this->debug=debug;
+}
+
+/*
+ * Set the limits of the printer used for the time of the commands.
+ */
+void GCodeParser::setLimits(const MachineLimits& limits)
+{
+	estimator.setLimits(limits);
+}
+
+const MachineLimits& GCodeParser::getLimits() const
+{
+	return estimator.getLimits();
+}
+
+int GCodeParser::parse(const string& line, Command& command)
+{
+	return parse(line.c_str(), line.length(), command);
+}
+
+/*
+ * Parse a line, a line number and checksum in it are checked and
+ * removed. command gets the line in upper case (text arguments like
+ * the message of M117 are kept as they are) and all values, its id is
+ * 0. The line is read once, nothing but the command text is copied.
+ * Returns: 0 on success, -1 if the line can not be sent
+ */
+int GCodeParser::parse(const char* line, size_t length, Command& command)
+{
+	GCodeMove move;
+	if(read(line, length, command, move))
+		return -1;
+	apply(move, command);
+	return 0;
+}
+
+/*
+ * The first step of parse(): set the text and the G and M code of
+ * command and the values given in the line in move. The position and
+ * feedrate of command are not set, the state of the parser is not
+ * used or changed.
+ * Returns: 0 on success, -1 if the line can not be sent
+ */
+int GCodeParser::read(const char* line, size_t length, Command& command, GCodeMove& move)
+{
+	int g=-1;
+	int m=-1;
+	move.words=0;
+	move.x=move.y=move.z=move.f=move.e=0.0;
+	move.s=move.p=move.i=move.j=0.0;
+	if(debug)
+		cout<<"New command: "<<string(line, length)<<endl;
+	GCodeTokenizer tokenizer(line, length);
+	GCodeWord word;
+	size_t begin=length;  // the command text, without line number and checksum
+	size_t end=0;
+	size_t textBegin=length;  // a text argument, not converted to upper case
+	size_t textEnd=length;
+	int result;
+	while((result=tokenizer.next(word))>0)
+	{
+		if(word.letter=='*')
+			continue;
+		if(word.letter=='N' && begin==length)
+			continue;  // the line number, an N behind the first word is an argument (M110 N-1)
+		if(begin==length)
+			begin=word.position;
+		end=word.position+word.length;
+		if(!word.hasValue)
+			continue;
+		switch(word.letter)
+		{
+		case 'G':
+			if(g<0)
+				g=(int)word.value;
+			break;
+		case 'M':
+			if(m<0)
+			{
+				m=(int)word.value;
+				if(BinaryGCode::hasText(m))
+				{
+					tokenizer.readText(textBegin, textEnd);
+					if(textEnd>textBegin)
+						end=textEnd;
+				}
+			}
+			break;
+		case 'X':
+			move.x=word.value;
+			move.words|=GCODE_WORD_X;
+			break;
+		case 'Y':
+			move.y=word.value;
+			move.words|=GCODE_WORD_Y;
+			break;
+		case 'Z':
+			move.z=word.value;
+			move.words|=GCODE_WORD_Z;
+			break;
+		case 'F':
+			move.f=word.value;
+			move.words|=GCODE_WORD_F;
+			break;
+		case 'E':
+			move.e=word.value;
+			move.words|=GCODE_WORD_E;
+			break;
+		case 'S':
+			move.s=word.value;
+			move.words|=GCODE_WORD_S;
+			break;
+		case 'P':
+			move.p=word.value;
+			move.words|=GCODE_WORD_P;
+			break;
+		case 'I':
+			move.i=word.value;
+			move.words|=GCODE_WORD_I;
+			break;
+		case 'J':
+			move.j=word.value;
+			move.words|=GCODE_WORD_J;
+			break;
+		}
+	}
+	if(result<0)
+	{
+		cerr<<"GCodeParser::parse(): "<<tokenizer.getError()<<" at column "<<tokenizer.getErrorPosition()+1<<": "<<string(line, length)<<endl;
+		return -1;
+	}
+	if(begin>=end)
+	{
+		// only comments, nothing to send
+		if(debug)
+			cout<<"No command in line: "<<string(line, length)<<endl;
+		return -1;
+	}
+
+	command.command.resize(end-begin);
+	char* text=&command.command[0];
+	size_t copied=0;
+	for(size_t i=begin; i<end; i++)
+	{
+		char c=line[i];
+		if(c>='a' && c<='z' && (i<textBegin || i>=textEnd))
+			c-=0x20;
+		text[copied++]=c;
+	}
+	command.command.resize(copied);
+	command.id=0;
+	command.time=0.0;
+	command.jobTime=-1.0;
+	command.m=m;
+	command.g=g;
+	return 0;
+}
+
+/*
+ * Returns: The new position of an axis from the value of a word
+ */
+static double target(double last, double value, bool relative)
+{
+	return relative ? last+value : value;
+}
+
+/*
+ * A relative value is taken as it is, (last+value)-last would be
+ * rounded depending on the position, so two parsers starting at
+ * different positions would never get the same moves.
+ * Returns: The distance an axis moves
+ */
+static double difference(double last, double next, double value, bool given, bool relative)
+{
+	if(relative)
+		return given ? value : 0.0;
+	return next-last;
+}
+
+/*
+ * The second step of parse(): set the position, feedrate and time of
+ * a command read by read() and make it the state for the next one.
+ */
+void GCodeParser::apply(const GCodeMove& move, Command& command)
+{
+	double newX=lastX;
+	double newY=lastY;
+	double newZ=lastZ;
+	double newF=(move.words & GCODE_WORD_F) ? move.f : lastF;
+	double newE=lastE;
+	switch(command.g)
+	{
+	case 0:
+	case 1:
+	case 2:
+	case 3:
+		if(move.words & GCODE_WORD_X)
+			newX=target(lastX, move.x, relative);
+		if(move.words & GCODE_WORD_Y)
+			newY=target(lastY, move.y, relative);
+		if(move.words & GCODE_WORD_Z)
+			newZ=target(lastZ, move.z, relative);
+		if(move.words & GCODE_WORD_E)
+			newE=target(lastE, move.e, relative || relativeE);
+		break;
+	case 28:  // home the given axes, all without axes
+		if(!(move.words & (GCODE_WORD_X | GCODE_WORD_Y | GCODE_WORD_Z)))
+			newX=newY=newZ=0.0;
+		if(move.words & GCODE_WORD_X)
+			newX=0.0;
+		if(move.words & GCODE_WORD_Y)
+			newY=0.0;
+		if(move.words & GCODE_WORD_Z)
+			newZ=0.0;
+		break;
+	case 90:
+		relative=false;
+		break;
+	case 91:
+		relative=true;
+		break;
+	case 92:  // set the position without moving
+		if(move.words & GCODE_WORD_X)
+			newX=move.x;
+		if(move.words & GCODE_WORD_Y)
+			newY=move.y;
+		if(move.words & GCODE_WORD_Z)
+			newZ=move.z;
+		if(move.words & GCODE_WORD_E)
+			newE=move.e;
+		break;
+	}
+	switch(command.m)
+	{
+	case 82:
+		relativeE=false;
+		break;
+	case 83:
+		relativeE=true;
+		break;
+	}
+	command.time=0.0;
+	command.x=newX;
+	command.y=newY;
+	command.z=newZ;
+	command.f=newF;
+
+	// Calculate the time this command will need
+	double delta[ESTIMATOR_AXES];
+	double length=0.0;
+	bool moving=command.g>=0 && command.g<=3;
+	if(moving && newF==0.0)
+	{
+		if(debug && !feedrateWarned)
+			cout<<"The feedrate is not set, assuming 100mm/sec"<<endl;
+		feedrateWarned=true;
+		newF=100.0;
+	}
+	switch(command.g)
+	{
+	case 2:  // arcs around the center at I J, clockwise
+	case 3:  // counter clockwise
+		if(move.words & (GCODE_WORD_I | GCODE_WORD_J))
+		{
+			double centerX=lastX+move.i;
+			double centerY=lastY+move.j;
+			double angle=atan2(newY-centerY, newX-centerX)-atan2(lastY-centerY, lastX-centerX);
+			if(command.g==2 && angle>=0.0)
+				angle-=2.0*M_PI;
+			else if(command.g==3 && angle<=0.0)
+				angle+=2.0*M_PI;
+			double arc=sqrt(move.i*move.i+move.j*move.j)*fabs(angle);
+			length=sqrt(arc*arc+(newZ-lastZ)*(newZ-lastZ));
+		}
+		// fall through
+	case 1:  // G1 command
+	case 0:  // G0 command
+		delta[0]=difference(lastX, newX, move.x, move.words & GCODE_WORD_X, relative);
+		delta[1]=difference(lastY, newY, move.y, move.words & GCODE_WORD_Y, relative);
+		delta[2]=difference(lastZ, newZ, move.z, move.words & GCODE_WORD_Z, relative);
+		delta[3]=difference(lastE, newE, move.e, move.words & GCODE_WORD_E, relative || relativeE);
+		command.time=estimator.move(delta, newF, length);
+		break;
+	case 4:  // dwell P milliseconds or S seconds
+		command.time=estimator.dwell((move.words & GCODE_WORD_P) ? move.p/1000.0 : move.s);
+		break;
+	case 28:
+		estimator.synchronize();
+		break;
+	}
+	switch(command.m)
+	{
+	case 104:
+	case 109:
+		if(move.words & GCODE_WORD_S)
+			command.time+=estimator.setTemperature(ESTIMATOR_HEATER_EXTRUDER, move.s, command.m==109);
+		break;
+	case 140:
+	case 190:
+		if(move.words & GCODE_WORD_S)
+			command.time+=estimator.setTemperature(ESTIMATOR_HEATER_BED, move.s, command.m==190);
+		break;
+	case 400:
+		estimator.synchronize();
+		break;
+	}
+	if(debug)
+		cout<<"Calculated time for command: "<<command.time<<" seconds"<<endl;
+	lastX=newX;
+	lastY=newY;
+	lastZ=newZ;
+	lastF=newF;
+	lastE=newE;
+}
+
+/*
+ * Forget the position, feedrate and modes, like at the start of a
+ * file.
+ */
+void GCodeParser::reset()
+{
+	lastX=0.0;
+	lastY=0.0;
+	lastZ=0.0;
+	lastF=0.0;
+	lastE=0.0;
+	relative=false;
+	relativeE=false;
+	feedrateWarned=false;
+	estimator.reset();
+}
+
+/*
+ * With relative extrusion (G91, M83) lastE is never the same without
+ * G92 E, but it only matters again for a move with absolute E after
+ * M82 or G90. Without compareE it is not compared, the commands which
+ * follow have to be checked with followE() then.
+ * Returns: true if the next commands will get the same values from
+ *          both parsers (with compareE), or the same values until
+ *          lastE matters again
+ */
+bool GCodeParser::sameState(const GCodeParser& other, bool compareE) const
+{
+	if(relative!=other.relative || relativeE!=other.relativeE)
+		return false;
+	if(compareE && lastE!=other.lastE)
+		return false;
+	return lastX==other.lastX && lastY==other.lastY && lastZ==other.lastZ &&
+		lastF==other.lastF && estimator==other.estimator;
+}
+
+/*
+ * Follow only E and the positioning modes of a command read by read(),
+ * without calculating its time, like apply() does.
+ * Returns: 1 if G92 E set lastE, 0 if the command does not depend on
+ *          lastE, -1 for a move with absolute E which does (it is not
+ *          followed then)
+ */
+int GCodeParser::followE(const GCodeMove& move, const Command& command)
+{
+	switch(command.g)
+	{
+	case 0:
+	case 1:
+	case 2:
+	case 3:
+		if(!(move.words & GCODE_WORD_E))
+			return 0;
+		if(!relative && !relativeE)
+			return -1;
+		lastE=target(lastE, move.e, true);
+		return 0;
+	case 90:
+		relative=false;
+		return 0;
+	case 91:
+		relative=true;
+		return 0;
+	case 92:
+		if(!(move.words & GCODE_WORD_E))
+			return 0;
+		lastE=move.e;
+		return 1;
+	}
+	switch(command.m)
+	{
+	case 82:
+		relativeE=false;
+		break;
+	case 83:
+		relativeE=true;
+		break;
+	}
+	return 0;
+}
+
+/*
+ * Take lastE from a parser which followed the same commands with
+ * followE().
+ */
+void GCodeParser::takeE(const GCodeParser& other)
+{
+	lastE=other.lastE;
+}
@@ -0,0 +1,88 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GCODEPARSER_HPP_
+#define GCODEPARSER_HPP_
+
+#include <string>
+#include <cstddef>
+#include "CommandQueue.hpp"
+#include "TimeEstimator.hpp"
+
+#define GCODE_WORD_X 0x01
+#define GCODE_WORD_Y 0x02
+#define GCODE_WORD_Z 0x04
+#define GCODE_WORD_F 0x08
+#define GCODE_WORD_E 0x10
+#define GCODE_WORD_S 0x20
+#define GCODE_WORD_P 0x40
+#define GCODE_WORD_I 0x80
+#define GCODE_WORD_J 0x100
+
+using namespace std;
+
+/*
+ * The values of a line, words tells which of them are given
+ * (GCODE_WORD_* flags).
+ */
+struct GCodeMove
+{
+	unsigned int words;
+	double x, y, z, f, e;
+	double s, p, i, j;
+};
+
+/*
+ * GCodeParser turns a G-code line into a Command: the G or M code,
+ * the target position and feedrate and the time the command will
+ * take. The position, feedrate, positioning modes (G90, G91, M82,
+ * M83) and the TimeEstimator of the previous commands are kept, so
+ * the lines have to be parsed in the order they are sent.
+ * parse() is done in two steps which can also be called on their own:
+ * read() only depends on the line, apply() adds the state of the
+ * previous commands. Parts of a file can be read by several parsers
+ * with a guessed state at their start and applied again with the
+ * right state until both parsers have the same state (sameState()),
+ * see JobCache::create().
+ */
+class GCodeParser
+{
+public:
+	GCodeParser();
+
+	void setDebug(bool debug);
+	void setLimits(const MachineLimits& limits);
+	const MachineLimits& getLimits() const;
+	int parse(const string& line, Command& command);
+	int parse(const char* line, size_t length, Command& command);
+	int read(const char* line, size_t length, Command& command, GCodeMove& move);
+	void apply(const GCodeMove& move, Command& command);
+	void reset();
+	bool sameState(const GCodeParser& other, bool compareE=true) const;
+	int followE(const GCodeMove& move, const Command& command);
+	void takeE(const GCodeParser& other);
+
+private:
+	bool debug;
+	double lastX, lastY, lastZ, lastF, lastE;
+	bool relative;  // G91
+	bool relativeE;  // M83
+	bool feedrateWarned;  // the missing feedrate is reported once, in debug mode
+	TimeEstimator estimator;
+};
+
+#endif /* GCODEPARSER_HPP_ */
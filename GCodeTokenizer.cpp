@@ -0,0 +1,234 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "GCodeTokenizer.hpp"
+
+// powers of ten which are exact doubles
+static const double powersOfTen[]=
+{
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+#define MAX_EXACT_POWER 22
+#define MAX_MANTISSA 900719925474099ULL  // digits are only added below 2^53/10
+
+GCodeTokenizer::GCodeTokenizer(const char* line, size_t length):
+line(line),
+end(line+length),
+current(line),
+error(NULL),
+errorPosition(0)
+{
+
+}
+
+/*
+ * Get the next word of the line.
+ * Returns: 1 if word was set, 0 at the end of the line, -1 on errors
+ */
+int GCodeTokenizer::next(GCodeWord& word)
+{
+	while(current<end)
+	{
+		char c=*current;
+		if(c==' ' || c=='\t' || c=='\r' || c=='\n')
+		{
+			current++;
+			continue;
+		}
+		if(c==';' || c=='%')
+		{
+			current=end;
+			break;
+		}
+		if(c=='(')
+		{
+			while(current<end && *current!=')')
+				current++;
+			if(current<end)
+				current++;
+			continue;
+		}
+		if(c=='*')
+		{
+			// the checksum is the XOR of all characters before it
+			const char* star=current;
+			int sum=0;
+			for(const char* p=line; p<star; p++)
+				sum^=(unsigned char)*p;
+			double value;
+			const char* stop=parseNumber(star+1, end, value);
+			if(stop==NULL)
+				return fail(star+1, "checksum expected");
+			if(value!=(double)sum)
+				return fail(star, "wrong checksum");
+			current=stop;
+			while(current<end && (*current==' ' || *current=='\t' || *current=='\r' || *current=='\n'))
+				current++;
+			if(current<end && *current!=';')
+				return fail(current, "text after the checksum");
+			word.letter='*';
+			word.hasValue=true;
+			word.value=value;
+			word.position=star-line;
+			word.length=stop-star;
+			current=end;
+			return 1;
+		}
+		if(c>='a' && c<='z')
+			c-=0x20;
+		if(c<'A' || c>'Z')
+			return fail(current, "unexpected character");
+		const char* start=current;
+		const char* stop=parseNumber(start+1, end, word.value);
+		word.hasValue=stop!=NULL;
+		if(stop==NULL)
+		{
+			stop=start+1;
+			word.value=0.0;
+		}
+		if(!isSeparator(stop))
+			return fail(stop, word.hasValue ? "unexpected character after the number" : "number expected");
+		word.letter=c;
+		word.position=start-line;
+		word.length=stop-start;
+		current=stop;
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * Take the rest of the line up to the checksum as the text argument
+ * of the last word (file names and messages), surrounding whitespace
+ * is not included. The checksum is returned by the next call of next().
+ */
+void GCodeTokenizer::readText(size_t& textBegin, size_t& textEnd)
+{
+	while(current<end && (*current==' ' || *current=='\t'))
+		current++;
+	const char* stop=current;
+	while(stop<end && *stop!='*')
+		stop++;
+	const char* last=stop;
+	while(last>current && (last[-1]==' ' || last[-1]=='\t' || last[-1]=='\r' || last[-1]=='\n'))
+		last--;
+	textBegin=current-line;
+	textEnd=last-line;
+	current=stop;
+}
+
+/*
+ * Returns: The description of the last error, NULL if there was none
+ */
+const char* GCodeTokenizer::getError()
+{
+	return error;
+}
+
+/*
+ * Returns: The column of the last error, starting at 0
+ */
+size_t GCodeTokenizer::getErrorPosition()
+{
+	return errorPosition;
+}
+
+/*
+ * Parse a decimal number with optional sign and fraction. There is no
+ * exponent, an 'E' after a number is the next word. The digits are
+ * collected in an integer which is scaled by an exact power of ten, so
+ * the value is correctly rounded for all numbers with up to 15
+ * significant digits.
+ * Returns: The end of the number, NULL if there is no number at begin
+ */
+const char* GCodeTokenizer::parseNumber(const char* begin, const char* end, double& value)
+{
+	const char* p=begin;
+	bool negative=false;
+	if(p<end && (*p=='-' || *p=='+'))
+	{
+		negative=*p=='-';
+		p++;
+	}
+	unsigned long long mantissa=0;
+	int scale=0;  // value is mantissa*10^-scale
+	bool digits=false;
+	while(p<end && *p>='0' && *p<='9')
+	{
+		if(mantissa<MAX_MANTISSA)
+			mantissa=mantissa*10+(*p-'0');
+		else
+			scale--;
+		digits=true;
+		p++;
+	}
+	if(p<end && *p=='.')
+	{
+		p++;
+		while(p<end && *p>='0' && *p<='9')
+		{
+			if(mantissa<MAX_MANTISSA)
+			{
+				mantissa=mantissa*10+(*p-'0');
+				scale++;
+			}
+			digits=true;
+			p++;
+		}
+	}
+	if(!digits)
+		return NULL;
+	double result=(double)mantissa;
+	while(scale>MAX_EXACT_POWER)
+	{
+		result/=powersOfTen[MAX_EXACT_POWER];
+		scale-=MAX_EXACT_POWER;
+	}
+	while(scale<-MAX_EXACT_POWER)
+	{
+		result*=powersOfTen[MAX_EXACT_POWER];
+		scale+=MAX_EXACT_POWER;
+	}
+	if(scale>0)
+		result/=powersOfTen[scale];
+	else if(scale<0)
+		result*=powersOfTen[-scale];
+	value=negative ? -result : result;
+	return p;
+}
+
+int GCodeTokenizer::fail(const char* position, const char* error)
+{
+	this->error=error;
+	errorPosition=position-line;
+	current=end;
+	return -1;
+}
+
+/*
+ * Returns: true if a word may end before position
+ */
+bool GCodeTokenizer::isSeparator(const char* position)
+{
+	if(position>=end)
+		return true;
+	char c=*position;
+	return c==' ' || c=='\t' || c=='\r' || c=='\n' || c==';' || c=='(' || c=='*' ||
+		(c>='A' && c<='Z') || (c>='a' && c<='z');
+}
@@ -0,0 +1,72 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GCODETOKENIZER_HPP_
+#define GCODETOKENIZER_HPP_
+
+#include <string>
+#include <cstddef>
+
+using namespace std;
+
+struct GCodeWord
+{
+	char letter;  // upper case, '*' for the checksum
+	bool hasValue;  // false for words like the X of "G28 X"
+	double value;
+	size_t position;  // column of the letter, starting at 0
+	size_t length;  // characters of the letter and the value
+};
+
+/*
+ * GCodeTokenizer splits a G-code line into its words in a single pass
+ * over the characters of the line, without copying or allocating
+ * anything. Every letter is a word, lower case letters are returned as
+ * upper case. Comments (after ';' or in parentheses, an unterminated
+ * one runs to the end of the line like in most firmwares), the '%' of
+ * program start and end and whitespace between the words are skipped.
+ * A checksum ("*" and a number) is compared with the line before it and
+ * returned as the word '*'. The line must stay unchanged while it is
+ * tokenized.
+ * After an error the position and a description of the error are kept
+ * for messages.
+ */
+class GCodeTokenizer
+{
+public:
+	GCodeTokenizer(const char* line, size_t length);
+
+	int next(GCodeWord& word);
+	void readText(size_t& textBegin, size_t& textEnd);
+
+	const char* getError();
+	size_t getErrorPosition();
+
+	static const char* parseNumber(const char* begin, const char* end, double& value);
+
+private:
+	int fail(const char* position, const char* error);
+	bool isSeparator(const char* position);
+
+	const char* line;
+	const char* end;
+	const char* current;
+	const char* error;
+	size_t errorPosition;
+};
+
+#endif /* GCODETOKENIZER_HPP_ */
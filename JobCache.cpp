@@ -0,0 +1,579 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "JobCache.hpp"
+#include "GCodeFile.hpp"
+#include "GCodeParser.hpp"
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <sys/stat.h>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+
+#define JOBCACHE_MAGIC "RMHJOB"
+
+using namespace boost::interprocess;
+
+JobCache::JobCache():
+mapping(NULL),
+region(NULL),
+header(NULL),
+startTimes(NULL),
+x(NULL),
+y(NULL),
+z(NULL),
+f(NULL),
+g(NULL),
+m(NULL),
+text(NULL),
+textSize(0),
+textPosition(0),
+position(0)
+{
+
+}
+
+JobCache::~JobCache()
+{
+	close();
+}
+
+string JobCache::getCacheName(string gCodeFileName)
+{
+	return gCodeFileName+JOBCACHE_EXTENSION;
+}
+
+/*
+ * A part of the G-code file parsed by one thread, with the arrays of
+ * the cache for its commands.
+ */
+struct JobChunk
+{
+	const char* begin;
+	const char* end;
+	GCodeParser parser;  // the (guessed) state at the start, then at the end of the part
+	vector<double> times;  // the time of the commands, the start times when the parts are joined
+	vector<float> x, y, z, f;
+	vector<boost::int16_t> g, m;
+	string text;  // one command per line
+	vector<pair<size_t, GCodeParser> > checkpoints;  // the state after some of the commands
+};
+
+/*
+ * Returns: The G or M code as it is stored in the cache, -1 for none
+ *          and for codes which do not fit
+ */
+static boost::int16_t toCode(int code)
+{
+	if(code<0 || code>numeric_limits<boost::int16_t>::max())
+		return -1;
+	return code;
+}
+
+/*
+ * Write an array of all parts.
+ */
+template<class T> static void writeArray(ofstream& cache, const vector<JobChunk>& chunks, vector<T> JobChunk::*array)
+{
+	for(size_t i=0; i<chunks.size(); i++)
+	{
+		const vector<T>& values=chunks[i].*array;
+		if(values.size())
+			cache.write((const char*)&values[0], values.size()*sizeof(T));
+	}
+}
+
+/*
+ * Find the next line which is not empty without its comment.
+ * Returns: false at end
+ */
+static bool nextLine(const char*& position, const char* end, const char*& lineBegin, const char*& lineEnd)
+{
+	while(position<end)
+	{
+		lineBegin=position;
+		lineEnd=(const char*)memchr(position, '\n', end-position);
+		if(lineEnd==NULL)
+			lineEnd=end;
+		position=lineEnd+1;
+		if(GCodeFile::trimLine(lineBegin, lineEnd))
+			return true;
+	}
+	return false;
+}
+
+static void parseChunk(JobChunk* chunk)
+{
+	Command command;
+	GCodeMove move;
+	const char* position=chunk->begin;
+	const char* begin;
+	const char* end;
+	size_t checkpoint=JOBCACHE_FIRST_CHECKPOINT;
+	while(nextLine(position, chunk->end, begin, end))
+	{
+		if(chunk->parser.read(begin, end-begin, command, move))
+			continue;
+		chunk->parser.apply(move, command);
+		chunk->times.push_back(command.time);
+		chunk->x.push_back(command.x);
+		chunk->y.push_back(command.y);
+		chunk->z.push_back(command.z);
+		chunk->f.push_back(command.f);
+		chunk->g.push_back(toCode(command.g));
+		chunk->m.push_back(toCode(command.m));
+		chunk->text+=command.command;
+		chunk->text+='\n';
+		if(chunk->times.size()==checkpoint)
+		{
+			chunk->checkpoints.push_back(make_pair(checkpoint, chunk->parser));
+			checkpoint*=2;
+		}
+	}
+}
+
+/*
+ * The state at a checkpoint is the same as the guessed one except for
+ * lastE, with relative extrusion. The guessed values are right until a
+ * move with absolute E, so only E and the modes are followed up to G92
+ * E or the end of the part.
+ * Returns: true if all following commands got the right values, the
+ *          state at the end of the part is right then as well
+ */
+static bool followE(JobChunk& chunk, const GCodeParser& parser, const char* position)
+{
+	GCodeParser follower=parser;
+	Command command;
+	GCodeMove move;
+	const char* begin;
+	const char* end;
+	while(nextLine(position, chunk.end, begin, end))
+	{
+		if(follower.read(begin, end-begin, command, move))
+			continue;
+		int result=follower.followE(move, command);
+		if(result<0)
+			return false;
+		if(result>0)
+			return true;
+	}
+	chunk.parser.takeE(follower);
+	return true;
+}
+
+/*
+ * Apply the commands of a part again, starting with the right state,
+ * until the state is the same as at a checkpoint of the guessed one.
+ * The following commands got the right values already.
+ */
+static void fixChunk(JobChunk& chunk, const GCodeParser& start)
+{
+	GCodeParser parser=start;
+	Command command;
+	GCodeMove move;
+	const char* position=chunk.begin;
+	const char* begin;
+	const char* end;
+	size_t index=0;
+	size_t checkpoint=0;
+	while(nextLine(position, chunk.end, begin, end))
+	{
+		if(parser.read(begin, end-begin, command, move))
+			continue;
+		parser.apply(move, command);
+		chunk.times[index]=command.time;
+		chunk.x[index]=command.x;
+		chunk.y[index]=command.y;
+		chunk.z[index]=command.z;
+		chunk.f[index]=command.f;
+		index++;
+		if(checkpoint<chunk.checkpoints.size() && chunk.checkpoints[checkpoint].first==index)
+		{
+			const GCodeParser& guessed=chunk.checkpoints[checkpoint].second;
+			if(parser.sameState(guessed))
+				return;
+			if(parser.sameState(guessed, false) && followE(chunk, parser, position))
+				return;
+			checkpoint++;
+		}
+	}
+	chunk.parser=parser;  // the guess was never right, all commands were applied again
+}
+
+/*
+ * Parse a G-code file and write its cache. The cache is written to a
+ * temporary file first, so open() never sees a half written cache.
+ * This may take a while for large files, it can be done in its own
+ * thread. The times of the commands are calculated with the given
+ * limits of the printer.
+ * Files larger than JOBCACHE_MIN_CHUNK are split at line ends and
+ * parsed by up to threads threads, 0 uses one per processor. The
+ * calling thread hashes the file meanwhile. Every part starts with the
+ * state after the first JOBCACHE_PROBE_SIZE bytes of the file as a
+ * guess, which is usually right about the positioning modes and
+ * temperatures. The commands at the start of every part are then
+ * applied again with the state at the end of the part before, until
+ * the state is the same as with the guess.
+ * Returns: 0 on success
+ */
+int JobCache::create(string gCodeFileName, int threads, const MachineLimits& limits)
+{
+	JobCacheHeader fileHeader;
+	memset(&fileHeader, 0, sizeof(fileHeader));
+	memcpy(fileHeader.magic, JOBCACHE_MAGIC, strlen(JOBCACHE_MAGIC));
+	fileHeader.version=JOBCACHE_VERSION;
+	fileHeader.commandSize=JOBCACHE_COMMAND_SIZE;
+	getLimitValues(limits, fileHeader.limits);
+	if(getFileInfo(gCodeFileName, fileHeader.sourceSize, fileHeader.sourceTime))
+		return -1;
+
+	file_mapping* source=NULL;
+	mapped_region* sourceRegion=NULL;
+	const char* data="";
+	if(fileHeader.sourceSize>0)
+	{
+		try
+		{
+			source=new file_mapping(gCodeFileName.c_str(), read_only);
+			sourceRegion=new mapped_region(*source, read_only);
+		}
+		catch(interprocess_exception& e)
+		{
+			cerr<<"JobCache::create(): Unable to map "<<gCodeFileName<<": "<<e.what()<<endl;
+			delete sourceRegion;
+			delete source;
+			return -1;
+		}
+		data=(const char*)sourceRegion->get_address();
+	}
+	size_t size=fileHeader.sourceSize;
+
+	if(threads<=0)
+		threads=boost::thread::hardware_concurrency();
+	size_t count=size/JOBCACHE_MIN_CHUNK;
+	if(count>(size_t)threads)
+		count=threads;
+	if(count<1)
+		count=1;
+	GCodeParser guess;
+	guess.setLimits(limits);
+	if(count>1)
+	{
+		Command command;
+		GCodeMove move;
+		const char* position=data;
+		const char* begin;
+		const char* end;
+		while(position<data+JOBCACHE_PROBE_SIZE && nextLine(position, data+size, begin, end))
+			if(guess.read(begin, end-begin, command, move)==0)
+				guess.apply(move, command);
+	}
+	vector<JobChunk> chunks(count);
+	const char* begin=data;
+	for(size_t i=0; i<count; i++)
+	{
+		const char* end=data+size;
+		size_t split=size/count*(i+1);
+		if(i+1<count && data+split>begin)
+		{
+			const char* lineEnd=(const char*)memchr(data+split, '\n', size-split);
+			if(lineEnd)
+				end=lineEnd+1;
+		}
+		chunks[i].begin=begin;
+		chunks[i].end=end;
+		if(i>0)
+			chunks[i].parser=guess;
+		else
+			chunks[i].parser.setLimits(limits);
+		begin=end;
+	}
+	boost::thread_group parsers;
+	for(size_t i=1; i<count; i++)
+		parsers.create_thread(boost::bind(&parseChunk, &chunks[i]));
+	if(count>1)
+		fileHeader.sourceHash=hashData(data, size, 14695981039346656037ULL);
+	parseChunk(&chunks[0]);
+	parsers.join_all();
+	if(count==1)
+		fileHeader.sourceHash=hashData(data, size, 14695981039346656037ULL);
+
+	// join the parts, the state at the start of every part is known now
+	for(size_t i=0; i<count; i++)
+	{
+		JobChunk& chunk=chunks[i];
+		if(i>0)
+			fixChunk(chunk, chunks[i-1].parser);
+		for(size_t j=0; j<chunk.times.size(); j++)
+		{
+			double time=chunk.times[j];
+			chunk.times[j]=fileHeader.totalTime;
+			fileHeader.totalTime+=time;  // in file order, like with one part
+		}
+		fileHeader.commandCount+=chunk.times.size();
+	}
+	delete sourceRegion;
+	delete source;
+	fileHeader.textOffset=sizeof(JobCacheHeader)+fileHeader.commandCount*JOBCACHE_COMMAND_SIZE;
+
+	string cacheName=getCacheName(gCodeFileName);
+	string temporaryName=cacheName+".tmp";
+	ofstream cache(temporaryName.c_str(), ios::out | ios::binary | ios::trunc);
+	if(!cache.is_open())
+	{
+		cerr<<"JobCache::create(): Unable to write "<<temporaryName<<endl;
+		return -1;
+	}
+	cache.write((const char*)&fileHeader, sizeof(fileHeader));
+	writeArray(cache, chunks, &JobChunk::times);
+	writeArray(cache, chunks, &JobChunk::x);
+	writeArray(cache, chunks, &JobChunk::y);
+	writeArray(cache, chunks, &JobChunk::z);
+	writeArray(cache, chunks, &JobChunk::f);
+	writeArray(cache, chunks, &JobChunk::g);
+	writeArray(cache, chunks, &JobChunk::m);
+	for(size_t i=0; i<count; i++)
+		cache.write(chunks[i].text.c_str(), chunks[i].text.length());
+	cache.close();
+	if(cache.fail())
+	{
+		cerr<<"JobCache::create(): Unable to write "<<temporaryName<<endl;
+		remove(temporaryName.c_str());
+		return -1;
+	}
+	remove(cacheName.c_str());  // rename does not replace files on Windows
+	if(rename(temporaryName.c_str(), cacheName.c_str()))
+	{
+		remove(temporaryName.c_str());
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Returns: The 64 bit FNV-1a hash of the content of a file
+ */
+boost::uint64_t JobCache::hashFile(string fileName)
+{
+	boost::uint64_t hash=14695981039346656037ULL;
+	ifstream file(fileName.c_str(), ios::in | ios::binary);
+	vector<char> buffer(1024*1024);
+	while(file)
+	{
+		file.read(&buffer[0], buffer.size());
+		hash=hashData(&buffer[0], file.gcount(), hash);
+	}
+	return hash;
+}
+
+/*
+ * Map the cache of a G-code file. It is only used if it was created
+ * with the current content of the G-code file and the same limits:
+ * if the size or the modification time differ, the hash of the file
+ * is compared.
+ * Returns: 0 if the cache can be used
+ */
+int JobCache::open(string gCodeFileName, const MachineLimits& limits)
+{
+	close();
+	boost::uint64_t sourceSize;
+	boost::int64_t sourceTime;
+	if(getFileInfo(gCodeFileName, sourceSize, sourceTime))
+		return -1;
+	double limitValues[JOBCACHE_LIMIT_VALUES];
+	getLimitValues(limits, limitValues);
+	string cacheName=getCacheName(gCodeFileName);
+	boost::uint64_t cacheSize;
+	boost::int64_t cacheTime;
+	if(getFileInfo(cacheName, cacheSize, cacheTime) || cacheSize<sizeof(JobCacheHeader))
+		return -1;
+	try
+	{
+		mapping=new file_mapping(cacheName.c_str(), read_only);
+		region=new mapped_region(*mapping, read_only);
+	}
+	catch(interprocess_exception& e)
+	{
+		cerr<<"JobCache::open(): Unable to map "<<cacheName<<": "<<e.what()<<endl;
+		close();
+		return -1;
+	}
+	region->advise(mapped_region::advice_sequential);
+	const char* data=(const char*)region->get_address();
+	header=(const JobCacheHeader*)data;
+	if(memcmp(header->magic, JOBCACHE_MAGIC, strlen(JOBCACHE_MAGIC))!=0 ||
+		header->version!=JOBCACHE_VERSION ||
+		header->commandSize!=JOBCACHE_COMMAND_SIZE ||
+		header->textOffset!=sizeof(JobCacheHeader)+header->commandCount*JOBCACHE_COMMAND_SIZE ||
+		header->textOffset>region->get_size() ||
+		header->sourceSize!=sourceSize ||
+		memcmp(header->limits, limitValues, sizeof(limitValues))!=0 ||
+		(header->sourceTime!=sourceTime && header->sourceHash!=hashFile(gCodeFileName)))
+	{
+		close();
+		return -1;
+	}
+	size_t count=header->commandCount;
+	startTimes=(const double*)(data+sizeof(JobCacheHeader));
+	x=(const float*)(startTimes+count);
+	y=x+count;
+	z=y+count;
+	f=z+count;
+	g=(const boost::int16_t*)(f+count);
+	m=g+count;
+	text=data+header->textOffset;
+	textSize=region->get_size()-header->textOffset;
+	return 0;
+}
+
+void JobCache::close()
+{
+	delete region;
+	region=NULL;
+	delete mapping;
+	mapping=NULL;
+	header=NULL;
+	startTimes=NULL;
+	x=y=z=f=NULL;
+	g=m=NULL;
+	text=NULL;
+	textSize=0;
+	textPosition=0;
+	position=0;
+}
+
+bool JobCache::isOpen()
+{
+	return header!=NULL;
+}
+
+bool JobCache::atEnd()
+{
+	return header==NULL || (boost::uint64_t)position>=header->commandCount;
+}
+
+/*
+ * Get the next command of the job. Its id is 0.
+ * Returns: false at the end of the job
+ */
+bool JobCache::readCommand(Command& command)
+{
+	if(atEnd())
+		return false;
+	const char* begin=text+textPosition;
+	const char* end=(const char*)memchr(begin, '\n', textSize-textPosition);
+	if(end==NULL)
+	{
+		cerr<<"JobCache::readCommand(): The cache is damaged"<<endl;
+		position=header->commandCount;
+		return false;
+	}
+	long i=position++;
+	textPosition=end+1-text;
+	command.id=0;
+	command.command.assign(begin, end-begin);
+	command.time=getStartTime(position)-startTimes[i];
+	command.jobTime=startTimes[i];
+	command.m=m[i];
+	command.g=g[i];
+	command.x=x[i];
+	command.y=y[i];
+	command.z=z[i];
+	command.f=f[i];
+	return true;
+}
+
+long JobCache::getCount()
+{
+	if(header==NULL)
+		return 0;
+	return header->commandCount;
+}
+
+/*
+ * Returns: The number of commands read so far
+ */
+long JobCache::getPosition()
+{
+	return position;
+}
+
+/*
+ * Returns: The calculated time of all commands of the job
+ */
+double JobCache::getTotalTime()
+{
+	if(header==NULL)
+		return 0.0;
+	return header->totalTime;
+}
+
+/*
+ * Returns: The calculated time of the commands before a position of
+ *          the job (0 to getCount()), in constant time
+ */
+double JobCache::getStartTime(long position)
+{
+	if(header==NULL || position<=0)
+		return 0.0;
+	if((boost::uint64_t)position>=header->commandCount)
+		return header->totalTime;
+	return startTimes[position];
+}
+
+int JobCache::getFileInfo(string fileName, boost::uint64_t& size, boost::int64_t& time)
+{
+	struct stat info;
+	if(stat(fileName.c_str(), &info))
+		return -1;
+	size=info.st_size;
+	time=info.st_mtime;
+	return 0;
+}
+
+/*
+ * Continue a FNV-1a hash with more data.
+ */
+boost::uint64_t JobCache::hashData(const char* data, size_t length, boost::uint64_t hash)
+{
+	for(size_t i=0; i<length; i++)
+	{
+		hash^=(unsigned char)data[i];
+		hash*=1099511628211ULL;
+	}
+	return hash;
+}
+
+/*
+ * Store the limits in the header in a fixed order.
+ */
+void JobCache::getLimitValues(const MachineLimits& limits, double* values)
+{
+	for(int i=0; i<ESTIMATOR_AXES; i++)
+	{
+		*values++=limits.maxFeedrate[i];
+		*values++=limits.maxAcceleration[i];
+	}
+	for(int i=0; i<ESTIMATOR_HEATERS; i++)
+		*values++=limits.heatingRate[i];
+	*values++=limits.junctionDeviation;
+	*values++=limits.lookahead;
+}
@@ -0,0 +1,118 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef JOBCACHE_HPP_
+#define JOBCACHE_HPP_
+
+#include <string>
+#include <boost/cstdint.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include "CommandQueue.hpp"
+#include "TimeEstimator.hpp"
+
+#define JOBCACHE_EXTENSION ".rmjob"
+#define JOBCACHE_VERSION 4
+#define JOBCACHE_MIN_CHUNK (4*1024*1024)  // smallest part of a file parsed by one thread
+#define JOBCACHE_PROBE_SIZE (64*1024)  // start of the file parsed for the state at the start of the parts
+#define JOBCACHE_FIRST_CHECKPOINT 16  // the state of a part is kept after 16, 32, 64, ... commands
+#define JOBCACHE_LIMIT_VALUES (2*ESTIMATOR_AXES+ESTIMATOR_HEATERS+2)
+#define JOBCACHE_COMMAND_SIZE (sizeof(double)+4*sizeof(float)+2*sizeof(boost::int16_t))
+
+using namespace std;
+
+struct JobCacheHeader
+{
+	char magic[8];  // "RMHJOB" and two zero bytes
+	boost::uint32_t version;
+	boost::uint32_t commandSize;  // bytes of the arrays per command, detects caches of an other build
+	boost::uint64_t sourceSize;
+	boost::int64_t sourceTime;  // modification time of the G-code file
+	boost::uint64_t sourceHash;
+	boost::uint64_t commandCount;
+	boost::uint64_t textOffset;  // file offset of the command text
+	double totalTime;
+	double limits[JOBCACHE_LIMIT_VALUES];  // the MachineLimits the times were calculated with
+};
+
+/*
+ * A JobCache is a G-code file parsed in advance. create() writes the
+ * parsed commands (codes, positions, calculated times and the command
+ * text as it is sent, without line number and checksum) into a file
+ * next to the G-code file, named like it with JOBCACHE_EXTENSION
+ * appended. open() maps that file and checks that it belongs to the
+ * current content of the G-code file and the limits of the printer,
+ * so a job can be sent again
+ * without parsing it again. The cache is written in the byte order of
+ * the machine, a cache of an other machine is ignored.
+ * Layout: JobCacheHeader, one array per value with commandCount
+ * entries (start times, X, Y, Z, F, G and M codes, see
+ * JOBCACHE_COMMAND_SIZE), then the command text with one command per
+ * line. The time of a command is the difference of the start times,
+ * the text is read in order, so neither needs an array of its own. A
+ * command takes 28 bytes plus its text, and the start times used for
+ * the progress are contiguous.
+ * create() splits large files into parts which are parsed by several
+ * threads, see GCodeParser for how the position at the start of a
+ * part is fixed afterwards.
+ */
+class JobCache
+{
+public:
+	JobCache();
+	~JobCache();
+
+	static string getCacheName(string gCodeFileName);
+	static int create(string gCodeFileName, int threads=0, const MachineLimits& limits=MachineLimits());
+	static boost::uint64_t hashFile(string fileName);
+
+	int open(string gCodeFileName, const MachineLimits& limits=MachineLimits());
+	void close();
+	bool isOpen();
+	bool atEnd();
+	bool readCommand(Command& command);
+
+	long getCount();
+	long getPosition();
+	double getTotalTime();
+	double getStartTime(long position);
+
+private:
+	JobCache(const JobCache&);
+	JobCache& operator=(const JobCache&);
+
+	static int getFileInfo(string fileName, boost::uint64_t& size, boost::int64_t& time);
+	static boost::uint64_t hashData(const char* data, size_t length, boost::uint64_t hash);
+	static void getLimitValues(const MachineLimits& limits, double* values);
+
+	boost::interprocess::file_mapping* mapping;
+	boost::interprocess::mapped_region* region;
+	const JobCacheHeader* header;
+	const double* startTimes;
+	const float* x;
+	const float* y;
+	const float* z;
+	const float* f;
+	const boost::int16_t* g;
+	const boost::int16_t* m;
+	const char* text;
+	size_t textSize;
+	size_t textPosition;  // start of the text of the next command
+	long position;
+};
+
+#endif /* JOBCACHE_HPP_ */
@@ -0,0 +1,57 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "LineHistory.hpp"
+
+LineHistory::LineHistory(size_t capacity)
+{
+	size_t size=1;
+	while(size<capacity)
+		size*=2;
+	entries.resize(size);
+	clear();
+}
+
+/*
+ * Keep a line which was written with the given line number.
+ */
+void LineHistory::add(long lineNumber, const string& line)
+{
+	Entry& entry=entries[lineNumber & (entries.size()-1)];
+	entry.lineNumber=lineNumber;
+	entry.line.assign(line);
+}
+
+/*
+ * Returns: The line written with the given line number, NULL if it is
+ *          too old or was never written
+ */
+const string* LineHistory::find(long lineNumber) const
+{
+	if(lineNumber<0)
+		return NULL;
+	const Entry& entry=entries[lineNumber & (entries.size()-1)];
+	if(entry.lineNumber!=lineNumber)
+		return NULL;
+	return &entry.line;
+}
+
+void LineHistory::clear()
+{
+	for(size_t i=0; i<entries.size(); i++)
+		entries[i].lineNumber=-1;
+}
@@ -0,0 +1,56 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LINEHISTORY_HPP_
+#define LINEHISTORY_HPP_
+
+#include <string>
+#include <vector>
+
+#define LINEHISTORY_SIZE 256  // lines kept for resends, more than ever are in flight
+
+using namespace std;
+
+/*
+ * LineHistory keeps the last sent lines as they were written to the
+ * port (ASCII with line number and checksum or binary packets), so a
+ * line the firmware asks for again with "Resend: N" is written again
+ * without encoding it again. The lines are kept in a ring indexed by
+ * the line number, the oldest line is overwritten by the newest one.
+ * The memory of a slot is reused, adding a line does not allocate
+ * memory once the slots are as long as the lines.
+ */
+class LineHistory
+{
+public:
+	LineHistory(size_t capacity=LINEHISTORY_SIZE);
+
+	void add(long lineNumber, const string& line);
+	const string* find(long lineNumber) const;
+	void clear();
+
+private:
+	struct Entry
+	{
+		long lineNumber;  // -1 if the slot is empty
+		string line;
+	};
+
+	vector<Entry> entries;  // the size is a power of two
+};
+
+#endif /* LINEHISTORY_HPP_ */
@@ -0,0 +1,224 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "LinkStatistics.hpp"
+#include <sstream>
+#include <iomanip>
+#include <boost/chrono.hpp>
+
+LatencyHistogram::LatencyHistogram()
+{
+	clear();
+}
+
+void LatencyHistogram::add(boost::int64_t microseconds)
+{
+	int bucket=0;
+	for(boost::int64_t limit=microseconds; limit>0 && bucket<LATENCY_BUCKETS-1; limit>>=1)
+		bucket++;
+	buckets[bucket]++;
+	count++;
+	sum+=microseconds;
+	if(microseconds>max)
+		max=microseconds;
+}
+
+void LatencyHistogram::clear()
+{
+	for(int i=0; i<LATENCY_BUCKETS; i++)
+		buckets[i]=0;
+	count=0;
+	sum=0;
+	max=0;
+}
+
+long LatencyHistogram::getCount() const
+{
+	return count;
+}
+
+long LatencyHistogram::getBucket(int bucket) const
+{
+	if(bucket<0 || bucket>=LATENCY_BUCKETS)
+		return 0;
+	return buckets[bucket];
+}
+
+/*
+ * Returns: The microseconds the latencies in a bucket are below, -1 for
+ *          the last bucket which has no limit
+ */
+boost::int64_t LatencyHistogram::getBucketLimit(int bucket)
+{
+	if(bucket>=LATENCY_BUCKETS-1)
+		return -1;
+	return (boost::int64_t)1<<bucket;
+}
+
+/*
+ * Returns: The mean latency in seconds
+ */
+double LatencyHistogram::getMean() const
+{
+	if(count==0)
+		return 0.0;
+	return sum/1e6/count;
+}
+
+/*
+ * Returns: The highest latency in seconds
+ */
+double LatencyHistogram::getMax() const
+{
+	return max/1e6;
+}
+
+/*
+ * Returns: The latency in seconds the given fraction of the latencies
+ *          is below, rounded up to the limit of its bucket
+ */
+double LatencyHistogram::getPercentile(double fraction) const
+{
+	long rank=(long)(fraction*count+0.5);
+	long counted=0;
+	for(int i=0; i<LATENCY_BUCKETS-1; i++)
+	{
+		counted+=buckets[i];
+		if(counted>=rank && counted>0)
+			return getBucketLimit(i)<max ? getBucketLimit(i)/1e6 : max/1e6;
+	}
+	return max/1e6;
+}
+
+LinkStatistics::LinkStatistics()
+{
+	clear();
+}
+
+void LinkStatistics::clear()
+{
+	for(int stage=0; stage<LATENCY_STAGES; stage++)
+		for(int i=0; i<COMMAND_CLASSES; i++)
+			histograms[stage][i].clear();
+	rateTime=0;
+	rateSent=0;
+	rateReceived=0;
+	sentRate=0.0;
+	receivedRate=0.0;
+	baud=0;
+}
+
+void LinkStatistics::addLatency(LatencyStage stage, CommandClass commandClass, boost::int64_t microseconds)
+{
+	histograms[stage][commandClass].add(microseconds);
+}
+
+const LatencyHistogram& LinkStatistics::getHistogram(LatencyStage stage, CommandClass commandClass) const
+{
+	return histograms[stage][commandClass];
+}
+
+/*
+ * Calculate the bytes per second sent and received since the last
+ * call from the byte counters of the port (see
+ * BoostComPort::getBytesSent()).
+ */
+void LinkStatistics::updateRates(boost::int64_t time, boost::uint64_t bytesSent, boost::uint64_t bytesReceived, int baud)
+{
+	this->baud=baud;
+	if(rateTime>0 && time>rateTime && bytesSent>=rateSent && bytesReceived>=rateReceived)
+	{
+		double seconds=(time-rateTime)/1e6;
+		sentRate=(bytesSent-rateSent)/seconds;
+		receivedRate=(bytesReceived-rateReceived)/seconds;
+	}
+	rateTime=time;
+	rateSent=bytesSent;
+	rateReceived=bytesReceived;
+}
+
+double LinkStatistics::getSentRate() const
+{
+	return sentRate;
+}
+
+double LinkStatistics::getReceivedRate() const
+{
+	return receivedRate;
+}
+
+/*
+ * Returns: The part of the baud rate used by the busier direction, a
+ *          byte takes 10 bits with start and stop bit, 0.0 if the baud
+ *          rate is not known
+ */
+double LinkStatistics::getUtilization() const
+{
+	if(baud<=0)
+		return 0.0;
+	double rate=sentRate>receivedRate ? sentRate : receivedRate;
+	return rate*10.0/baud;
+}
+
+/*
+ * Returns: The statistics as text, a line for the link and one for
+ *          every command class and stage with latencies
+ */
+string LinkStatistics::toString() const
+{
+	const char* stages[]={"queued", "acknowledged"};
+	ostringstream text;
+	text<<fixed<<setprecision(1);
+	text<<"link: sent "<<sentRate<<" B/s, received "<<receivedRate<<" B/s, utilization "<<getUtilization()*100.0<<"%"<<endl;
+	text<<setprecision(3);
+	for(int stage=0; stage<LATENCY_STAGES; stage++)
+		for(int i=0; i<COMMAND_CLASSES; i++)
+		{
+			const LatencyHistogram& histogram=histograms[stage][i];
+			if(histogram.getCount()==0)
+				continue;
+			text<<getClassName((CommandClass)i)<<" "<<stages[stage]<<": "<<histogram.getCount()<<" commands, mean "<<histogram.getMean()*1000.0<<" ms, 50% "<<histogram.getPercentile(0.5)*1000.0<<" ms, 99% "<<histogram.getPercentile(0.99)*1000.0<<" ms, max "<<histogram.getMax()*1000.0<<" ms"<<endl;
+		}
+	return text.str();
+}
+
+CommandClass LinkStatistics::classify(int g, int m)
+{
+	if(g>=0 && g<=3)
+		return COMMAND_MOVE;
+	if(m==105)
+		return COMMAND_TEMPERATURE;
+	if(m==109 || m==190 || m==116)
+		return COMMAND_HEATING;
+	return COMMAND_OTHER;
+}
+
+const char* LinkStatistics::getClassName(CommandClass commandClass)
+{
+	const char* names[]={"G0-G3", "M105", "heating", "other"};
+	if(commandClass<0 || commandClass>=COMMAND_CLASSES)
+		return "";
+	return names[commandClass];
+}
+
+/*
+ * Returns: A monotonic time in microseconds
+ */
+boost::int64_t LinkStatistics::getTime()
+{
+	return boost::chrono::duration_cast<boost::chrono::microseconds>(boost::chrono::steady_clock::now().time_since_epoch()).count();
+}
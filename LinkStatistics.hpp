@@ -0,0 +1,103 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LINKSTATISTICS_HPP_
+#define LINKSTATISTICS_HPP_
+
+#include <string>
+#include <boost/cstdint.hpp>
+
+#define LATENCY_BUCKETS 26  // bucket 0 is below 1 us, bucket i up to 2^i us, the last one is unbounded (over 16 s)
+
+using namespace std;
+
+enum CommandClass
+{
+	COMMAND_MOVE=0,  // G0 to G3
+	COMMAND_TEMPERATURE,  // M105
+	COMMAND_HEATING,  // M109, M190 and M116, which wait for the heaters
+	COMMAND_OTHER,
+	COMMAND_CLASSES
+};
+
+enum LatencyStage
+{
+	LATENCY_QUEUED=0,  // from queuing a command until it is written
+	LATENCY_ACKNOWLEDGED,  // from writing a command until its ok
+	LATENCY_STAGES
+};
+
+/*
+ * LatencyHistogram counts latencies in buckets which double in width,
+ * so adding one is a few shifts and an increment and the memory is
+ * fixed, with a resolution of a factor of two from a microsecond to
+ * many seconds.
+ */
+class LatencyHistogram
+{
+public:
+	LatencyHistogram();
+
+	void add(boost::int64_t microseconds);
+	void clear();
+	long getCount() const;
+	long getBucket(int bucket) const;
+	static boost::int64_t getBucketLimit(int bucket);
+	double getMean() const;
+	double getMax() const;
+	double getPercentile(double fraction) const;
+
+private:
+	long buckets[LATENCY_BUCKETS];
+	long count;
+	boost::int64_t sum;
+	boost::int64_t max;
+};
+
+/*
+ * LinkStatistics collects where the time of the commands goes: a
+ * latency histogram for each command class and stage, and the bytes
+ * per second sent and received compared to the baud rate of the link.
+ * The RepRapHost class feeds it, see RepRapHost::getStatistics().
+ */
+class LinkStatistics
+{
+public:
+	LinkStatistics();
+
+	void clear();
+	void addLatency(LatencyStage stage, CommandClass commandClass, boost::int64_t microseconds);
+	const LatencyHistogram& getHistogram(LatencyStage stage, CommandClass commandClass) const;
+	void updateRates(boost::int64_t time, boost::uint64_t bytesSent, boost::uint64_t bytesReceived, int baud);
+	double getSentRate() const;
+	double getReceivedRate() const;
+	double getUtilization() const;
+	string toString() const;
+
+	static CommandClass classify(int g, int m);
+	static const char* getClassName(CommandClass commandClass);
+	static boost::int64_t getTime();
+
+private:
+	LatencyHistogram histograms[LATENCY_STAGES][COMMAND_CLASSES];
+	boost::int64_t rateTime;  // time of the last updateRates(), 0 before the first one
+	boost::uint64_t rateSent, rateReceived;  // bytes at that time
+	double sentRate, receivedRate;  // bytes per second
+	int baud;
+};
+
+#endif /* LINKSTATISTICS_HPP_ */
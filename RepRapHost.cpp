@@ -27,53 +27,121 @@
  */
 
 #include "RepRapHost.h"
-//#include <boost/config/warning_disable.hpp>
-#include <boost/spirit/include/qi.hpp>
-#include <boost/spirit/include/phoenix_core.hpp>
-#include <boost/spirit/include/phoenix_operator.hpp>
-#include <boost/spirit/include/phoenix_stl.hpp>
+#include "GCodeTokenizer.hpp"
+#include <sstream>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <cmath>
+#include <boost/chrono.hpp>
+#include <boost/bind.hpp>
 
-RepRapHost::RepRapHost() :
+/*
+ * The port may use an io_service shared with other hosts and a smaller
+ * receive buffer, see BoostComPort::BoostComPort().
+ */
+RepRapHost::RepRapHost(boost::asio::io_service* sharedService, size_t bufferSize) :
 comStatus(STANDBY),
-remainingTime(0.0),
+comPort(sharedService, bufferSize),
+queuedTime(0),
+job(NULL),
+jobCache(NULL),
+jobLookahead(JOB_LOOKAHEAD),
+jobTimeRead(0.0),
+jobTimeDone(0.0),
 tempExtruder(0.0),
 tempBed(0.0),
-tempExpression("([A-Z]): *([0-9]+.?[0-9]*)"),
+extruderCount(0),
 nextLineNumber(0),
+encodedLineNumber(0),
+linesSent(0),
+binaryLinesSent(0),
+resendNext(-1),
+ignoreResends(0),
+skipOks(0),
+resends(0),
+checksumErrors(0),
+temperatureInterval(0.0),
+autoReport(true),
+autoReportRequested(false),
+lastTemperature(0.0),
+lastTemperatureRequest(0.0),
+temperaturePolls(0),
+sentTime(0),
+sentClass(COMMAND_OTHER),
+statisticsInterval(0.0),
+nextStatisticsExport(0.0),
+stallRecovery(RECOVERY_POLL),
+lastProgress(0.0),
+stallRecoveries(0),
+pollInFlight(false),
+pollOksBefore(0),
+previousResponse(RESPONSE_UNKNOWN),
+stalls(0),
+outstandingBytes(0),
+firmwareFreeLines(-1),
 hashEnabled(true),
 debug(false),
+streamingEnabled(false),
+firmwareBufferSize(63),
+binaryProtocol(BINARY_PROTOCOL_NONE),
 hardwareX(0.0),
 hardwareY(0.0),
 hardwareZ(0.0),
-hardwareF(0.0),
-lastX(0.0),
-lastY(0.0),
-lastZ(0.0),
-lastF(0.0),
-lastE(0.0)
+hardwareF(0.0)
 {
-	
+	timeouts[STANDBY]=0.0;
+	timeouts[WAITING_FOR_OK]=TIMEOUT_OK;
+	timeouts[WAITING_FOR_TEMP]=TIMEOUT_TEMPERATURE;
+	timeouts[WAITING_FOR_TEMP_ACHIEVED]=TIMEOUT_HEATING;
+	for(int i=0; i<RECOVERIES; i++)
+		recoveries[i]=0;
+	comPort.setReceiveHandler(boost::bind(&RepRapHost::onReceived, this));
 }
 
 RepRapHost::~RepRapHost()
 {
-
+	comPort.close();  // stops the I/O thread before the members it uses are destroyed
 }
 
 void RepRapHost::setDebug(bool debug)
 {
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
 	this->debug=debug;
+	parser.setDebug(debug);
 }
 
+/*
+ * Connect to the printer. port is the name of a serial port or an URI
+ * like serial:///dev/ttyUSB0?baud=250000, tcp://host:port or
+ * pty:///tmp/printer (see Transport.hpp).
+ * Returns: 0 if connected
+ */
 int RepRapHost::connect(string port, int baud)
 {
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
 	if(comPort.isOpended())
 		comPort.close();
+	resetStreaming();
+	autoReportRequested=false;
 	return comPort.open(port, baud);
 }
 
+/*
+ * Service the serial port in its own thread, see
+ * BoostComPort::setIoThreadEnabled(). The thread also reads the answers
+ * and writes the next lines, see onReceived(). Takes effect on the next
+ * connect().
+ */
+void RepRapHost::setIoThreadEnabled(bool enable, int realtimePriority)
+{
+	comPort.setIoThreadEnabled(enable, realtimePriority);
+}
+
 int RepRapHost::disconnect()
 {
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
 	return comPort.close();
 }
 
@@ -82,299 +150,1073 @@ bool RepRapHost::isConnected()
 	return comPort.isOpended();
 }
 
+/*
+ * Returns: The name of the connected port, for pty:// the device the
+ *          printer (or a simulation of it) has to open
+ */
+string RepRapHost::getPortName()
+{
+	return comPort.getName();
+}
+
+/*
+ * Set the line number of the next line written. The lines written so
+ * far can not be resent any more.
+ */
 void RepRapHost::setNextLineNumber(int nextLineNumber)
 {
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
 	this->nextLineNumber=nextLineNumber;
+	history.clear();
+	resendNext=-1;
+	ignoreResends=0;
 }
 
-void RepRapHost::refreshRemainingTime()
+/*
+ * Returns: The calculated time of the queued commands plus an estimate
+ *          for the part of the job which is not read yet, in constant
+ *          time
+ */
+double RepRapHost::getRemainingTime()
 {
-	remainingTime=0.0;
-	for(unsigned int i=0; i<commands.size(); i++)
-		remainingTime+=commands[i].time;
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
+	return fromMicroseconds(queuedTime)+getJobTimeUnread();
 }
 
-double RepRapHost::getRemainingTime()
+/*
+ * Returns: The calculated time of the part of the job which is not
+ *          read yet. For job files it is estimated from the time per
+ *          byte of the part read so far.
+ */
+double RepRapHost::getJobTimeUnread()
 {
-	return remainingTime;
+	if(jobCache)
+		return jobCache->getTotalTime()-jobCache->getStartTime(jobCache->getPosition());
+	if(job==NULL || job->getPosition()==0)
+		return 0.0;
+	double unread=job->getSize()-job->getPosition();
+	return jobTimeRead/job->getPosition()*unread;
 }
 
-Command* RepRapHost::addCommand(string cmdStr, bool putAtEnd, bool removeWhenDouble)
+/*
+ * Add a command to the queue, at the end or in front of all others.
+ * With removeWhenDouble the command is not added if the first queued
+ * command is the same.
+ * Returns: The id of the queued command for findCommand() and
+ *          cancelCommand(), 0 if the command was not accepted
+ */
+CommandId RepRapHost::addCommand(string cmdStr, bool putAtEnd, bool removeWhenDouble)
 {
-	if(removeWhenDouble && commands.size()>0 && commands[0].command==cmdStr)
-		return &commands[0];
-		
-	namespace qi = boost::spirit::qi;
-	namespace ascii = boost::spirit::ascii;
-	namespace phoenix = boost::phoenix;
-	using qi::double_;
-	using qi::int_;
-	using qi::phrase_parse;
-	using qi::_1;
-	using ascii::space;
-	using qi::lit;
-	using phoenix::ref;
-	
-	int g=-1;
-	int m=-1;
-	double newX=lastX;
-	double newY=lastY;
-	double newZ=lastZ;
-	double newF=lastF;
-	double newE=lastE;
-	if(debug)
-		cout<<"New command: "<<cmdStr<<endl;
-	cmdStr=toUpper(cmdStr);
-	//cout<<"upper case command: "<<cmdStr<<endl;
-	string::iterator begin=cmdStr.begin();
-	string::iterator end=cmdStr.end();
-	qi::phrase_parse(begin, end,
-			//  Begin grammar
-			(
-					((lit('G') > int_[ref(g)=_1]) | (lit('M') > int_[ref(m)=_1]))
-					>>
-					(
-							(lit('X')>double_[ref(newX)=_1]) ^
-							(lit('Y')>double_[ref(newY)=_1]) ^
-							(lit('Z')>double_[ref(newZ)=_1]) ^
-							(lit('F')>double_[ref(newF)=_1]) ^
-							(lit('E')>double_[ref(newE)=_1])
-					)
-			)
-			,
-			//  End grammar
-			space);
-	//cout<<"x: "<<x<<", y: "<<y<<", z: "<<z<<", e: "<<e<<", f: "<<f<<", m: "<<m<<", g: "<<g<<endl;
-	
-	if(cmdStr.find("*")!=string::npos)
-	{
-		cout<<"The gcode file you choosed is not (yet) supported because it already contains hashes. Remove the hashes or fix this program to remove them ;)";
-		//commands.clear();
-		return NULL;
-	}
-	string hashedCommand;
-	if(hashEnabled)
-	{
-		hashedCommand="N";
-		hashedCommand+=int2String(nextLineNumber++)+" "+cmdStr+" *";
-		hashedCommand+=getHash(hashedCommand);
-		cout<<"Converted command to: "<<hashedCommand<<endl;
-	}
-	else
-	{
-		hashedCommand=cmdStr;
-	}
-	Command commandStruct;
-	commandStruct.time=0.0;
-	commandStruct.command=hashedCommand;
-	commandStruct.m=m;
-	commandStruct.g=g;
-	commandStruct.x=newX;
-	commandStruct.y=newY;
-	commandStruct.z=newZ;
-	commandStruct.f=newF;
-	
-	// Calculate the time this command will need
-	double dx;
-	double dy;
-	double dz;
-	double distance;
-	
-	if(newF==0.0)
-	{
-		cout<<"The feedrate is not set, assuming 100mm/sec"<<endl;
-		newF=100.0;
-	}
-	switch(m)
-	{
-	case -1:
-		break;
-	default:
-		commandStruct.time=0.0;
-	}
-	switch(g)
-	{
-	case -1:
-		break;
-	case 1:  // G1 command
-	case 0:  // G0 command
-		dx=lastX-newX;
-		dy=lastY-newY;
-		dz=lastZ-newZ;
-		distance=sqrt(dx*dx+dy*dy+dz*dz);
-		commandStruct.time=distance/newF*60.0;
-		break;
-	default:
-		commandStruct.time=0.0;
-	}
-	if(debug)
-		cout<<"Calculated time for command: "<<commandStruct.time<<" seconds"<<endl;
-	lastX=newX;
-	lastY=newY;
-	lastZ=newZ;
-	lastF=newF;
-	lastE=newE;
-	remainingTime+=commandStruct.time;
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
+	if(removeWhenDouble && commands.size()>0 && commands.front().command==cmdStr)
+		return commands.front().id;
+	Command command;
+	if(parser.parse(cmdStr, command))
+		return 0;
+	return queueCommand(command, putAtEnd);
+}
+
+/*
+ * Add a parsed command to the queue. The line number and the checksum
+ * are added when it is sent, see encodeCommand().
+ * Returns: The id of the queued command
+ */
+CommandId RepRapHost::queueCommand(Command command, bool putAtEnd)
+{
+	queuedTime+=toMicroseconds(command.time);
+	command.queued=LinkStatistics::getTime();
 	if(putAtEnd)
+		return commands.pushBack(command);
+	else
+		return commands.pushFront(command);
+}
+
+/*
+ * Send the commands of an opened G-code file. Only lookahead commands
+ * are queued at a time, the queue is refilled from the file while
+ * commands are sent, so sending starts immediately and the memory used
+ * does not depend on the size of the file. The file must stay open
+ * until the job is finished or clear() is called.
+ */
+void RepRapHost::setJob(GCodeFile* file, int lookahead)
+{
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
+	job=file;
+	jobCache=NULL;
+	jobLookahead=lookahead;
+	jobTimeRead=0.0;
+	jobTimeDone=0.0;
+	refillJob();
+}
+
+/*
+ * Send the commands of a job cache (see JobCache.hpp). The commands
+ * are already parsed, only line numbers and checksums are added.
+ */
+void RepRapHost::setJob(JobCache* cache, int lookahead)
+{
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
+	job=NULL;
+	jobCache=cache;
+	jobLookahead=lookahead;
+	jobTimeRead=0.0;
+	jobTimeDone=0.0;
+	refillJob();
+}
+
+/*
+ * Returns: The part of the job done so far (0.0 to 1.0) weighted by
+ *          the calculated time of the sent commands, -1.0 if there is
+ *          no job. Jobs without calculated time are weighted by the
+ *          commands or bytes read.
+ */
+double RepRapHost::getJobProgress()
+{
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
+	if(job==NULL && jobCache==NULL)
+		return -1.0;
+	double total=jobTimeDone+getJobTimeQueued()+getJobTimeUnread();
+	if(total>0.0)
+		return jobTimeDone/total;
+	if(jobCache)
+		return jobCache->getCount() ? (double)jobCache->getPosition()/jobCache->getCount() : 1.0;
+	if(job->getSize()==0)
+		return 1.0;
+	return (double)job->getPosition()/job->getSize();
+}
+
+/*
+ * Returns: The calculated time of the commands of the job which are
+ *          read but not sent yet
+ */
+double RepRapHost::getJobTimeQueued()
+{
+	if(jobCache)
+		return jobCache->getStartTime(jobCache->getPosition())-jobTimeDone;
+	return jobTimeRead-jobTimeDone;
+}
+
+void RepRapHost::refillJob()
+{
+	if(jobCache)
 	{
-		commands.push_back(commandStruct);
-		return &commands.back();
+		Command command;
+		while((int)commands.size()<jobLookahead && jobCache->readCommand(command))
+			queueCommand(command);
+		return;
 	}
-	else
+	if(job==NULL)
+		return;
+	string line;
+	Command command;
+	while((int)commands.size()<jobLookahead && job->readLine(line))
 	{
-		commands.insert(commands.begin(), commandStruct);
-		return &(*commands.begin());
+		if(parser.parse(line, command))
+			continue;
+		command.jobTime=jobTimeRead;
+		jobTimeRead+=command.time;
+		queueCommand(command);
 	}
 }
 
+/*
+ * Copy a queued command. A copy is returned because the I/O thread may
+ * send the command as soon as hostMutex is released.
+ * Returns: 0 on success, -1 if the command has been sent or cancelled
+ */
+int RepRapHost::findCommand(CommandId id, Command& command)
+{
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
+	const Command* queued=commands.find(id);
+	if(queued==NULL)
+		return -1;
+	command=*queued;
+	return 0;
+}
+
+/*
+ * Remove a queued command so it will not be sent.
+ * Returns: 0 on success, -1 if the command is not queued any more
+ */
+int RepRapHost::cancelCommand(CommandId id)
+{
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
+	Command* command=commands.find(id);
+	if(command==NULL)
+		return -1;
+	queuedTime-=toMicroseconds(command->time);
+	commands.cancel(id);
+	return 0;
+}
+
 void RepRapHost::timerTick()
 {
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
 	if(!comPort.isOpended())
 	{
 		comStatus=STANDBY;
+		resetStreaming();
 		return;
 	}
-	Command command;
-	string answer;
-	char* buffer;
-	int size;
-	
 	comPort.poll();
+	refillJob();
+	readResponses();
+	checkWatchdog();
+	requestTemperatures();
+	exportStatistics();
 	
-	if(comStatus==STANDBY)
+	if(comStatus!=STANDBY)
+		return;
+	if(streamingEnabled && !streamCommands())
+		return;
+	if(resendNext>=0)
 	{
-		if(!commands.size())
-			return;
-		command=commands[0];
-		command.command+="\n";
-		comPort.clearBuffers();  // Make shure there is nothing old left in the buffer
-		comPort.write((char*)command.command.c_str(), command.command.length());
-		hardwareX=command.x;
-		hardwareY=command.y;
-		hardwareZ=command.z;
-		hardwareF=command.f;
-		
-		
-		remainingTime-=command.time;
-		commands.erase(commands.begin());
-		if(command.m==105)
-			comStatus=WAITING_FOR_TEMP;
-		else if(command.m==109 || command.m==116)
-			comStatus=WAITING_FOR_TEMP_ACHIEVED;
-		else
+		// a resend request which came after the ok, wait for the ok of the written lines
+		vector<string> lines;
+		int count=takeResendLines(lines, false);
+		comPort.writeLines(lines);
+		if(count>0)
+		{
+			skipOks+=count-1;
 			comStatus=WAITING_FOR_OK;
-		if(debug)
-			cout<<"Send command: "<<command.command.substr(0, command.command.length()-1)<<endl;
+			lastProgress=now();
+		}
+		return;
 	}
-	else if(comStatus==WAITING_FOR_TEMP)
+	if(!commands.size())
+		return;
+	Command command=sendNextCommand();
+	if(command.m==105)
+		comStatus=WAITING_FOR_TEMP;
+	else if(command.m==109 || command.m==116)
+		comStatus=WAITING_FOR_TEMP_ACHIEVED;
+	else
+		comStatus=WAITING_FOR_OK;
+}
+
+/*
+ * Called by the I/O thread after it received data (see
+ * setIoThreadEnabled()), so an ok is answered with the next line at
+ * once, however late the next timerTick() of the caller is. The public
+ * methods which use the state of the communication take hostMutex.
+ * Returns: false if the caller holds it, the I/O thread tries again
+ *          shortly
+ */
+bool RepRapHost::onReceived()
+{
+	boost::recursive_mutex::scoped_try_lock lock(hostMutex);
+	if(!lock.owns_lock())
+		return false;
+	timerTick();
+	return true;
+}
+
+/*
+ * Read the responses of the firmware and pass them to their handlers,
+ * see ResponseParser. Temperatures are taken from every response which
+ * reports them, with or without ok.
+ */
+void RepRapHost::readResponses()
+{
+	FirmwareResponse response;
+	while(comPort.readLine(responseLine)>0)
 	{
-		// TODO: A timeout is missing
-		buffer=new char[1024];
-		size=comPort.readUntil(buffer, 1000, (char*)"\n", 1, false);
-		if(size<=0)
+		const char* line=responseLine.data();
+		ResponseParser::parse(line, line+responseLine.length(), response);
+		if(response.type!=RESPONSE_WAIT)
+			lastProgress=now();  // "wait" is sent when the firmware has nothing to do
+		if(response.hasTool || response.hasBed || response.extruders)
+			onTemperature(response);
+		switch(response.type)
 		{
-			delete[] buffer;
-			return;
+		case RESPONSE_OK:
+			onOk(response);
+			break;
+		case RESPONSE_RESEND:
+			onResend(response);
+			break;
+		case RESPONSE_ERROR:
+			onError(response);
+			break;
+		case RESPONSE_BUSY:
+			onBusy(response);
+			break;
+		case RESPONSE_WAIT:
+			onWait(response);
+			break;
+		case RESPONSE_ECHO:
+			onEcho(response);
+			break;
+		case RESPONSE_ACHIEVED:
+			onAchieved(response);
+			break;
+		default:
+			if(debug)
+				cout<<"Got answer: "<<responseLine;
+			break;
 		}
-		buffer[size]=0;
-		if(string(buffer).find("ok")!=string::npos)
+		previousResponse=response.type;
+	}
+}
+
+/*
+ * An ok acknowledges the command sent by the send/ok path or the
+ * oldest line in flight of the streaming mode. If the firmware sends
+ * extended answers like "ok N10 P15 B3" the number of free command
+ * buffer slots (B) limits the number of lines in flight as well.
+ */
+void RepRapHost::onOk(const FirmwareResponse& response)
+{
+	stallRecoveries=0;
+	if(pollInFlight && takePollOk(response))
+		return;
+	if(comStatus!=STANDBY)
+	{
+		if(skipOks>0)
 		{
-			delete[] buffer;
+			skipOks--;  // the ok of a rejected line
 			return;
 		}
-		//cout<<"answer size: "<<size<<endl;
-		buffer[size-1]=0;
-		answer=buffer;
-		delete[] buffer;
-		// Waiting for temperature is a little bit complicated because
-		// there are different answers depending on the firmware and
-		// firmware version. We will try to guess the correct method.
-		// Because of the fact that I have no idea of regular expressions
-		// I have no idea whether this will work everywhere.
-		if(debug)
-			cout<<"Got answer: "<<answer<<endl;
-		string::const_iterator start, end;
-		start=answer.begin();
-		end=answer.end();
-		boost::match_results<std::string::const_iterator> what;
-		boost::match_flag_type flags = boost::match_default;
-		//boost::regex tempExpression(re);
-		while(boost::regex_search(start, end, what, tempExpression, flags))
-		{
-			string strTempType=what[1];
-			string strTemp=what[2];
-			double temp=string2Double(strTemp);
-			if(strTempType=="T")
-				tempExtruder=temp;
-			else if(strTempType=="B")
-				tempBed=temp;
-			else
-				cout<<"Unable to interprete thw temperature answer: "<<what[0]<<endl;
-			if(debug)
-				cout<<"Temp type: "<<strTempType<<", Temp: "<<temp<<endl;
-			start = what[0].second;
-			flags |= boost::match_prev_avail;
-			flags |= boost::match_not_bob;
-		}
+		comStatus=STANDBY;
+		statistics.addLatency(LATENCY_ACKNOWLEDGED, sentClass, LinkStatistics::getTime()-sentTime);
 		if(debug)
-			cout<<"Finished interpreting the answer..."<<endl;
-		// TODO: This is not a very good way to obmit the ok answer
+			cout<<"Got answer: "<<responseLine<<"This answer was interpreted as \"ok\""<<endl;
+		return;
+	}
+	if(!outstandingLines.empty())
+	{
+		const OutstandingLine& line=outstandingLines.front();
+		if(line.commandClass<COMMAND_CLASSES)
+			statistics.addLatency(LATENCY_ACKNOWLEDGED, line.commandClass, LinkStatistics::getTime()-line.sent);
+		outstandingBytes-=line.length;
+		outstandingLines.pop_front();
+	}
+	if(response.freeLines>=0)
+	{
+		// lines which are still in the receive buffer will take a slot too
+		firmwareFreeLines=response.freeLines-outstandingLines.size();
+		if(firmwareFreeLines<0)
+			firmwareFreeLines=0;
+	}
+}
+
+/*
+ * The ok of the WATCHDOG_POLL comes after the oks of the lines written
+ * before it, and it has the temperatures or follows them on a line of
+ * their own. If it arrives while some of these oks are still to come,
+ * they were lost and the lines are acknowledged with it. Oks which were
+ * only late are taken as usual, so the poll never counts as the ok of
+ * another line. A temperature line only tells the poll apart as long as
+ * the firmware is not asked for reports with M155, which may come
+ * between any two oks.
+ * Returns: true if the ok was the one of the poll
+ */
+bool RepRapHost::takePollOk(const FirmwareResponse& response)
+{
+	bool temperatures=response.hasTool || response.hasBed || response.extruders
+		|| (previousResponse==RESPONSE_TEMPERATURE && !autoReportRequested);
+	if(pollOksBefore>0 && !(temperatures && comStatus!=WAITING_FOR_TEMP))
+	{
+		pollOksBefore--;
+		return false;
+	}
+	if(pollOksBefore>0 && comStatus!=STANDBY)
+	{
+		comStatus=STANDBY;  // the ok of the line sent by the send/ok path was lost
+		skipOks=0;
+	}
+	while(pollOksBefore>0 && !outstandingLines.empty())
+	{
+		outstandingBytes-=outstandingLines.front().length;
+		outstandingLines.pop_front();
+		pollOksBefore--;
+	}
+	outstandingBytes-=strlen(WATCHDOG_POLL);
+	pollInFlight=false;
+	pollOksBefore=0;
+	return true;
+}
+
+void RepRapHost::onTemperature(const FirmwareResponse& response)
+{
+	lastTemperature=now();
+	if(response.hasTool)
+		tempExtruder=response.tool;
+	if(response.hasBed)
+		tempBed=response.bed;
+	for(int i=0; i<response.extruders; i++)
+		tempExtruders[i]=response.extruder[i];
+	if(response.extruders>extruderCount)
+		extruderCount=response.extruders;
+	if(debug)
+		cout<<"Temperatures: extruder "<<tempExtruder<<", bed "<<tempBed<<endl;
+}
+
+void RepRapHost::onError(const FirmwareResponse& response)
+{
+	if(response.checksumError)
+		checksumErrors++;
+	if(debug)
+		cout<<"Got error: "<<responseLine;
+}
+
+/*
+ * "busy:" is sent while a long command like G28 or G29 is executed. The
+ * firmware is still working, so the watchdog must not count the time
+ * since the last ok as a stall.
+ */
+void RepRapHost::onBusy(const FirmwareResponse& response)
+{
+	lastProgress=now();
+	stallRecoveries=0;
+	if(debug)
+		cout<<"Firmware is busy: "<<responseLine;
+}
+
+/*
+ * "wait" is sent when the command buffer of the firmware ran empty. It
+ * is no progress, a host which lost an ok sees nothing else.
+ */
+void RepRapHost::onWait(const FirmwareResponse& response)
+{
+	if(debug)
+		cout<<"Firmware is waiting: "<<responseLine;
+}
+
+void RepRapHost::onEcho(const FirmwareResponse& response)
+{
+	if(debug)
+		cout<<"Got message: "<<responseLine;
+}
+
+/*
+ * The heaters reached their target, the ok of the M109 or M116 follows.
+ */
+void RepRapHost::onAchieved(const FirmwareResponse& response)
+{
+	if(debug)
+		cout<<"Temperature achieved: "<<responseLine;
+}
+
+/*
+ * Call timerTick() until nothing changes any more, so all received
+ * answers are handled and the next command is sent in one call. Use
+ * this when the host is woken up by received data (see getPortHandle())
+ * or by new commands instead of a fixed timer.
+ */
+void RepRapHost::service()
+{
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
+	for(int i=0; i<16; i++)
+	{
+		ComStatus oldStatus=comStatus;
+		long oldLinesSent=linesSent;
+		int oldAvailable=comPort.available();
+		timerTick();
+		if(comStatus==oldStatus && linesSent==oldLinesSent && comPort.available()==oldAvailable)
+			break;
+	}
+}
+
+/*
+ * Returns: true if there is nothing to send and no answer is expected
+ */
+bool RepRapHost::isIdle()
+{
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
+	return comStatus==STANDBY && commands.empty() && outstandingLines.empty() && (job==NULL || job->atEnd()) && (jobCache==NULL || jobCache->atEnd());
+}
+
+/*
+ * Get the file descriptor of the serial port which becomes readable
+ * when an answer arrives, see BoostComPort::getNativeHandle().
+ * Returns: The file descriptor or -1 if there is none
+ */
+int RepRapHost::getPortHandle()
+{
+	return comPort.getNativeHandle();
+}
+
+/*
+ * Returns: The number of reads of the port which completed with data or
+ *          an error, see BoostComPort::getReadEvents()
+ */
+long RepRapHost::getPortEvents()
+{
+	return comPort.getReadEvents();
+}
+
+/*
+ * Send the first command of the queue and remove it from the queue.
+ */
+Command RepRapHost::sendNextCommand()
+{
+	bool binary;
+	string line=encodeCommand(commands.front().command, binary);
+	Command command=takeNextCommand();
+	if(binary)
+		binaryLinesSent++;
+	comPort.write((char*)line.c_str(), line.length());
+	lineWritten(line);
+	return command;
+}
+
+/*
+ * Remove the first command from the queue as if it was sent. The
+ * caller has to write it, see encodeCommand().
+ */
+Command RepRapHost::takeNextCommand()
+{
+	Command command=commands.front();
+	hardwareX=command.x;
+	hardwareY=command.y;
+	hardwareZ=command.z;
+	hardwareF=command.f;
+	queuedTime-=toMicroseconds(command.time);
+	if(command.jobTime>=0.0)
+		jobTimeDone=command.jobTime+command.time;
+	commands.popFront();
+	linesSent++;
+	sentTime=LinkStatistics::getTime();
+	sentClass=LinkStatistics::classify(command.g, command.m);
+	statistics.addLatency(LATENCY_QUEUED, sentClass, sentTime-command.queued);
+	if(debug)
+		cout<<"Send command: "<<command.command<<endl;
+	return command;
+}
+
+/*
+ * Get the bytes to write for a command: a binary packet if the
+ * firmware understands the binary protocol and the command can be
+ * encoded, else the ASCII line with its line end. If hashes are enabled
+ * the next line number and the checksum are added, call lineWritten()
+ * when the line is written.
+ */
+string RepRapHost::encodeCommand(const string& command, bool& binary)
+{
+	string line=command;
+	if(hashEnabled)
+	{
+		encodedLineNumber=getLineNumber(command);
+		line="N"+int2String(encodedLineNumber)+" "+command+" *";
+		line+=getHash(line);
 		if(debug)
-			cout<<"Now I will delete the current buffer because some firmware will send a ok\\n after the temperature"<<endl;
-		comPort.clearBuffers();
-		comStatus=STANDBY;
+			cout<<"Converted command to: "<<line<<endl;
 	}
-	else if(comStatus==WAITING_FOR_TEMP_ACHIEVED)
+	string packet;
+	binary=binaryProtocol!=BINARY_PROTOCOL_NONE && BinaryGCode::encode(line, binaryProtocol, packet)==0;
+	if(binary)
+		return packet;
+	return line+"\n";
+}
+
+/*
+ * An M110 with an N argument sets the number of its own line, so
+ * "M110 N-1" is written as "N-1 M110 N-1" and the next line is N0
+ * for the host and the firmware.
+ * Returns: The line number to write the command with
+ */
+int RepRapHost::getLineNumber(const string& command)
+{
+	GCodeTokenizer tokenizer(command.c_str(), command.length());
+	GCodeWord word;
+	if(tokenizer.next(word)<=0 || word.letter!='M' || word.value!=110.0)
+		return nextLineNumber;
+	while(tokenizer.next(word)>0)
+	{
+		if(word.letter=='N' && word.hasValue)
+			return (int)word.value;
+	}
+	return nextLineNumber;
+}
+
+/*
+ * Keep a line returned by encodeCommand() which was written for resends
+ * and count the line number up.
+ */
+void RepRapHost::lineWritten(const string& line)
+{
+	lastProgress=now();
+	if(!hashEnabled)
+		return;
+	history.add(encodedLineNumber, line);
+	nextLineNumber=encodedLineNumber+1;
+}
+
+/*
+ * A rejected line and all lines written after it are written again
+ * from the line history, see takeResendLines(). The firmware rejects
+ * every line in flight behind the rejected one with the same request,
+ * these requests are ignored.
+ */
+void RepRapHost::onResend(const FirmwareResponse& response)
+{
+	long lineNumber=response.lineNumber;
+	if(debug)
+		cout<<"Got resend request: "<<responseLine;
+	if(ignoreResends>0)
+	{
+		ignoreResends--;
+		return;
+	}
+	long lastWritten=resendNext>=0 ? resendNext-1 : nextLineNumber-1;
+	if(lineNumber==lastWritten+1)
+		return;  // a line written again by the watchdog was received already
+	if(lineNumber<0 || lineNumber>lastWritten || history.find(lineNumber)==NULL)
+	{
+		cerr<<"RepRapHost::onResend(): Line "<<lineNumber<<" can not be resent"<<endl;
+		return;
+	}
+	resends++;
+	// The ok answers of the lines before the rejected one came first, so
+	// only the lines from the rejected one on are in flight. This also
+	// corrects the count if two lines were merged by a lost line end.
+	while((long)outstandingLines.size()>lastWritten-lineNumber+1)
+	{
+		outstandingBytes-=outstandingLines.front().length;
+		outstandingLines.pop_front();
+	}
+	if(comStatus==STANDBY && pollOksBefore>(int)outstandingLines.size())
+		pollOksBefore=outstandingLines.size();
+	ignoreResends=lastWritten-lineNumber;
+	resendNext=lineNumber;
+	if(comStatus!=STANDBY)
+	{
+		// the ok of the rejected line follows, wait for the ok of the written lines
+		vector<string> lines;
+		skipOks+=takeResendLines(lines, false);
+		comPort.writeLines(lines);
+	}
+}
+
+/*
+ * Detect a stall: the host waits for an answer of the firmware, but
+ * nothing was received or written for the timeout of the state. The
+ * ok or the line end of the last line may be lost, so the host would
+ * wait forever. The stall is recovered as set by setStallRecovery(),
+ * if that does not help WATCHDOG_RECOVERIES times in a row the job is
+ * aborted.
+ */
+void RepRapHost::checkWatchdog()
+{
+	if(comStatus==STANDBY && outstandingLines.empty())
+		return;
+	ComStatus state=comStatus==STANDBY ? WAITING_FOR_OK : comStatus;
+	double time=now();
+	if(timeouts[state]<=0.0 || time-lastProgress<timeouts[state])
+		return;
+	lastProgress=time;
+	stalls++;
+	StallRecovery recovery=stallRecovery;
+	if(++stallRecoveries>WATCHDOG_RECOVERIES)
+		recovery=RECOVERY_ABORT;
+	const string* lastLine=history.find(nextLineNumber-1);
+	if(recovery==RECOVERY_RESEND && (lastLine==NULL || resendNext>=0))
+		recovery=RECOVERY_POLL;  // without line numbers the firmware can not reject a line twice
+	recoveries[recovery]++;
+	onStall(state, recovery);
+	if(recovery==RECOVERY_POLL)
 	{
-		// TODO: A timeout is missing
-		buffer=new char[1024];
-		size=comPort.readUntil(buffer, 1000, (char*)"achieved", 1, false);
-		if(size<=0)
+		if(!pollInFlight)
 		{
-			delete[] buffer;
-			return;
+			// its ok comes after those of all lines written before, see takePollOk()
+			string poll=WATCHDOG_POLL;
+			comPort.write((char*)poll.c_str(), poll.length());
+			pollInFlight=true;
+			pollOksBefore=comStatus!=STANDBY ? skipOks+1 : outstandingLines.size();
+			outstandingBytes+=poll.length();
 		}
-		if(debug)
-			cout<<"Temperature is achieved, continuing..."<<endl;
-		comPort.clearBuffers();
+	}
+	else if(recovery==RECOVERY_RESEND)
+	{
+		comPort.write((char*)lastLine->c_str(), lastLine->length());
+	}
+	else
+	{
+		clear();
+		resetStreaming();
 		comStatus=STANDBY;
+		stallRecoveries=0;
 	}
-	else if(comStatus==WAITING_FOR_OK)
+}
+
+/*
+ * Keep the temperatures up to date without stealing round trips from
+ * the print: the firmware is asked once to report them by itself
+ * (M155), and temperatures in any answer, like "ok T:..", count as a
+ * report. M105 is only queued if no report arrived for an interval
+ * (plus TEMPERATURE_LATE) while the host is idle, or for
+ * TEMPERATURE_STALE intervals while it prints.
+ */
+void RepRapHost::requestTemperatures()
+{
+	if(temperatureInterval<=0.0)
+		return;
+	if(autoReport && !autoReportRequested)
+	{
+		autoReportRequested=true;
+		addCommand("M155 S"+int2String((int)ceil(temperatureInterval)), false);
+	}
+	double time=now();
+	if(time-lastTemperatureRequest<temperatureInterval)
+		return;
+	double age=time-lastTemperature;
+	if(isIdle() ? age<temperatureInterval+TEMPERATURE_LATE : age<TEMPERATURE_STALE*temperatureInterval)
+		return;
+	lastTemperatureRequest=time;
+	temperaturePolls++;
+	addCommand("M105", false, true);
+}
+
+/*
+ * Called when a stall is detected, before it is recovered.
+ */
+void RepRapHost::onStall(ComStatus state, StallRecovery recovery)
+{
+	const char* states[]={"streaming", "ok", "temperature", "heating"};
+	const char* actions[]={"polling", "writing the last line again", "aborting the job"};
+	if(debug)
+		cout<<"No answer from the printer for "<<timeouts[state]<<"s while waiting for "<<states[comStatus]<<", "<<actions[recovery]<<endl;
+}
+
+/*
+ * Take the lines to write again for a resend request from the line
+ * history. In the streaming window only the lines which fit into the
+ * receive buffer of the firmware are taken, the others follow with the
+ * next ok answers.
+ * Returns: The number of lines added to lines
+ */
+int RepRapHost::takeResendLines(vector<string>& lines, bool window)
+{
+	int count=0;
+	while(resendNext>=0 && resendNext<nextLineNumber)
 	{
-		// TODO: A timeout is missing
-		buffer=new char[1024];
-		size=comPort.readUntil(buffer, 1000, (char*)"\n", 1, false);
-		if(size<=0)
+		const string* line=history.find(resendNext);
+		if(line==NULL)
 		{
-			delete[] buffer;
-			return;
+			cerr<<"RepRapHost::takeResendLines(): Line "<<resendNext<<" is not in the history any more"<<endl;
+			break;
 		}
-		buffer[size-1]=0;
-		answer=buffer;
-		delete[] buffer;
-		if(toLower(answer).find("ok")!=string::npos)
+		int length=line->length();
+		if(window)
 		{
-			comStatus=STANDBY;
-			if(debug)
-			{
-				cout<<"Got answer: "<<answer<<endl;;
-				cout<<"This answer was interpreted as \"ok\""<<endl;
-			}
+			if(!outstandingLines.empty() && (firmwareFreeLines==0 || outstandingBytes+length>firmwareBufferSize))
+				return count;
+			OutstandingLine outstanding={length, 0, COMMAND_CLASSES};
+			outstandingLines.push_back(outstanding);
+			outstandingBytes+=length;
+			if(firmwareFreeLines>0)
+				firmwareFreeLines--;
 		}
-		else
+		lines.push_back(*line);
+		resendNext++;
+		count++;
+	}
+	resendNext=-1;
+	return count;
+}
+
+/*
+ * Streaming mode: Instead of waiting for the ok of every command, send
+ * as many commands as fit into the receive buffer of the firmware and
+ * count the ok answers (character counting), see onOk().
+ * Commands with a special answer (M105, M109, M116) are sent by the
+ * normal send/ok path when all other commands are acknowledged.
+ * Returns: true if the next command has to be sent by the normal path
+ */
+bool RepRapHost::streamCommands()
+{
+	vector<string> lines;  // all lines of this tick are written at once
+	takeResendLines(lines, true);
+	bool specialCommand=false;
+	while(resendNext<0 && commands.size())
+	{
+		if(commands.front().m==105 || commands.front().m==109 || commands.front().m==116)
 		{
-			if(debug)
-			{
-				cout<<"Got unknown answer when waiting for \"ok\": "<<answer<<endl;
-				cout<<"Will treat this answer as ok too, no idea what else to do..."<<endl;
-				// TODO: Try catch some default errors like "bad M/G-Code", ...
-			}
+			specialCommand=true;
+			break;
 		}
+		bool binary;
+		string line=encodeCommand(commands.front().command, binary);
+		int length=line.length();
+		// without outstanding lines no ok can correct a wrong count of free lines, so one line is always sent
+		if(!outstandingLines.empty() && (firmwareFreeLines==0 || outstandingBytes+length>firmwareBufferSize))
+			break;
+		takeNextCommand();
+		if(binary)
+			binaryLinesSent++;
+		lines.push_back(line);
+		lineWritten(line);
+		OutstandingLine outstanding={length, sentTime, sentClass};
+		outstandingLines.push_back(outstanding);
+		outstandingBytes+=length;
+		if(firmwareFreeLines>0)
+			firmwareFreeLines--;
 	}
+	comPort.writeLines(lines);
+	return specialCommand && outstandingLines.empty() && resendNext<0;
+}
+
+void RepRapHost::resetStreaming()
+{
+	outstandingLines.clear();
+	outstandingBytes=0;
+	firmwareFreeLines=-1;
+	resendNext=-1;
+	ignoreResends=0;
+	skipOks=0;
+	pollInFlight=false;
+	pollOksBefore=0;
+}
+
+/*
+ * Enable or disable the streaming mode, see streamCommands().
+ */
+void RepRapHost::setStreamingEnabled(bool enable)
+{
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
+	if(enable!=streamingEnabled)
+		resetStreaming();
+	streamingEnabled=enable;
+}
+
+bool RepRapHost::getStreamingEnabled()
+{
+	return streamingEnabled;
+}
+
+/*
+ * Set the limits of the printer used to calculate the time of the
+ * commands, see TimeEstimator.
+ */
+void RepRapHost::setMachineLimits(const MachineLimits& limits)
+{
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
+	parser.setLimits(limits);
+}
+
+const MachineLimits& RepRapHost::getMachineLimits()
+{
+	return parser.getLimits();
+}
+
+/*
+ * Set the size of the receive buffer of the firmware in bytes. The
+ * streaming mode never has more unacknowledged bytes in flight.
+ */
+void RepRapHost::setFirmwareBufferSize(int size)
+{
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
+	firmwareBufferSize=size;
+}
+
+int RepRapHost::getFirmwareBufferSize()
+{
+	return firmwareBufferSize;
+}
+
+/*
+ * Number of lines sent since the program was started.
+ */
+long RepRapHost::getLinesSent()
+{
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
+	return linesSent;
+}
+
+/*
+ * Send commands in the binary protocol of the given version
+ * (BINARY_PROTOCOL_V1 or BINARY_PROTOCOL_V2, see BinaryGCode.hpp) if
+ * the firmware understands it, BINARY_PROTOCOL_NONE sends ASCII lines.
+ * Commands which can not be encoded are always sent as ASCII lines.
+ */
+void RepRapHost::setBinaryProtocol(int version)
+{
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
+	binaryProtocol=version;
+}
+
+int RepRapHost::getBinaryProtocol()
+{
+	return binaryProtocol;
+}
+
+/*
+ * Number of lines sent as binary packets since the program was started.
+ */
+long RepRapHost::getBinaryLinesSent()
+{
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
+	return binaryLinesSent;
+}
+
+/*
+ * Number of resend requests of the firmware since the program was
+ * started, without the requests of lines in flight behind a rejected
+ * line.
+ */
+long RepRapHost::getResends()
+{
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
+	return resends;
+}
+
+/*
+ * Number of checksum errors reported by the firmware since the program
+ * was started.
+ */
+long RepRapHost::getChecksumErrors()
+{
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
+	return checksumErrors;
+}
+
+/*
+ * Returns: A copy of the latency histograms of the commands sent since
+ *          the statistics were cleared and the rates of the link since
+ *          the previous call
+ */
+LinkStatistics RepRapHost::getStatistics()
+{
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
+	statistics.updateRates(LinkStatistics::getTime(), comPort.getBytesSent(), comPort.getBytesReceived(), comPort.getBaud());
+	return statistics;
+}
+
+void RepRapHost::clearStatistics()
+{
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
+	statistics.clear();
+}
+
+/*
+ * Write the statistics (see LinkStatistics::toString()) every given
+ * seconds to a file, or to cout if no file name is given. 0 stops it.
+ */
+void RepRapHost::setStatisticsExport(double seconds, string fileName)
+{
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
+	statisticsInterval=seconds;
+	statisticsFileName=fileName;
+	nextStatisticsExport=now()+seconds;
+}
+
+void RepRapHost::exportStatistics()
+{
+	if(statisticsInterval<=0.0)
+		return;
+	double time=now();
+	if(time<nextStatisticsExport)
+		return;
+	nextStatisticsExport=time+statisticsInterval;
+	string text=getStatistics().toString();
+	if(statisticsFileName.empty())
+	{
+		cout<<text;
+		return;
+	}
+	ofstream file(statisticsFileName.c_str(), ios::app);
+	if(!file)
+	{
+		cerr<<"RepRapHost::exportStatistics(): Unable to open "<<statisticsFileName<<endl;
+		return;
+	}
+	file<<text;
+}
+
+/*
+ * Monitor the temperatures every given seconds, 0 stops it. With
+ * autoReport the firmware is asked to report them by itself (M155)
+ * and only polled with M105 if the reports do not arrive, see
+ * requestTemperatures().
+ */
+void RepRapHost::setTemperatureInterval(double seconds, bool autoReport)
+{
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
+	if(seconds!=temperatureInterval || autoReport!=this->autoReport)
+		autoReportRequested=false;
+	temperatureInterval=seconds;
+	this->autoReport=autoReport;
+}
+
+/*
+ * Returns: Seconds since temperatures were received the last time
+ */
+double RepRapHost::getTemperatureAge()
+{
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
+	return now()-lastTemperature;
+}
+
+/*
+ * Returns: Number of M105 queued to monitor the temperatures, see
+ *          setTemperatureInterval()
+ */
+long RepRapHost::getTemperaturePolls()
+{
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
+	return temperaturePolls;
+}
+
+/*
+ * Set the seconds without an answer of the firmware after which the
+ * watchdog recovers a stall in a state (WAITING_FOR_OK for sent
+ * commands and the streaming mode, WAITING_FOR_TEMP for M105,
+ * WAITING_FOR_TEMP_ACHIEVED for M109 and M116), 0 disables it.
+ */
+void RepRapHost::setTimeout(ComStatus state, double seconds)
+{
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
+	if(state>STANDBY && state<COM_STATES)
+		timeouts[state]=seconds;
+}
+
+double RepRapHost::getTimeout(ComStatus state)
+{
+	if(state>STANDBY && state<COM_STATES)
+		return timeouts[state];
+	return 0.0;
+}
+
+/*
+ * Set how a stall is recovered, see checkWatchdog().
+ */
+void RepRapHost::setStallRecovery(StallRecovery recovery)
+{
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
+	stallRecovery=recovery;
+}
+
+StallRecovery RepRapHost::getStallRecovery()
+{
+	return stallRecovery;
+}
+
+/*
+ * Number of stalls detected by the watchdog since the program was
+ * started.
+ */
+long RepRapHost::getStalls()
+{
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
+	return stalls;
+}
+
+/*
+ * Number of stalls recovered in the given way since the program was
+ * started. Stalls which were recovered in vain too often are aborted.
+ */
+long RepRapHost::getRecoveries(StallRecovery recovery)
+{
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
+	if(recovery<0 || recovery>=RECOVERIES)
+		return 0;
+	return recoveries[recovery];
 }
 
 void RepRapHost::setHashEnabled(bool enable)
 {
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
 	hashEnabled=enable;
 }
 
@@ -435,39 +1277,95 @@ string RepRapHost::getHash(string cmd)
 
 double RepRapHost::getTempExtruder()
 {
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
 	return tempExtruder;
 }
 
+/*
+ * Returns: The temperature of an extruder of a firmware which reports
+ *          them as T0:, T1:, ..., for other firmware the temperature
+ *          of the active extruder for extruder 0
+ */
+double RepRapHost::getTempExtruder(int extruder)
+{
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
+	if(extruder>=0 && extruder<extruderCount)
+		return tempExtruders[extruder];
+	if(extruder==0)
+		return tempExtruder;
+	return 0.0;
+}
+
+/*
+ * Returns: The number of extruders the firmware reported temperatures
+ *          for as T0:, T1:, ..., 0 if it only reports T:
+ */
+int RepRapHost::getExtruderCount()
+{
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
+	return extruderCount;
+}
+
 double RepRapHost::getTempBed()
 {
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
 	return tempBed;
 }
 
 void RepRapHost::clear()
 {
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
 	commands.clear();
-	remainingTime=0.0;
+	queuedTime=0;
+	job=NULL;
+	jobCache=NULL;
 }
 
-iostream& RepRapHost::enableConsoleStream()
+ConsoleTap& RepRapHost::enableConsoleTap()
 {
-	return comPort.enableStream();
+	return comPort.enableConsoleTap();
 }
 
-void RepRapHost::disableConsoleStream()
+void RepRapHost::disableConsoleTap()
 {
-	comPort.disableStream();
+	comPort.disableConsoleTap();
 }
 
 int RepRapHost::commandsLeft()
 {
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
 	return commands.size();
 }
 
 void RepRapHost::getXYZF(double& x, double& y, double& z, double& f)
 {
+	boost::recursive_mutex::scoped_lock lock(hostMutex);
 	x=this->hardwareX;
 	y=this->hardwareY;
 	z=this->hardwareZ;
 	f=this->hardwareF;
 }
+
+/*
+ * The time of the queued commands is summed up in whole microseconds,
+ * so adding and removing the same commands gives exactly the same sum
+ * again and it never has to be recalculated from the queue.
+ */
+boost::int64_t RepRapHost::toMicroseconds(double seconds)
+{
+	return (boost::int64_t)floor(seconds*1e6+0.5);
+}
+
+double RepRapHost::fromMicroseconds(boost::int64_t microseconds)
+{
+	return microseconds/1e6;
+}
+
+/*
+ * Returns: A monotonic time in seconds
+ */
+double RepRapHost::now()
+{
+	boost::chrono::duration<double> time=boost::chrono::steady_clock::now().time_since_epoch();
+	return time.count();
+}
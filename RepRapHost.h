@@ -20,43 +20,66 @@
 
 #include <string>
 #include <vector>
+#include <deque>
 #include "BoostComPort.hpp"
-#include <boost/regex.hpp>
+#include "BinaryGCode.hpp"
+#include "CommandQueue.hpp"
+#include "GCodeFile.hpp"
+#include "GCodeParser.hpp"
+#include "JobCache.hpp"
+#include "LineHistory.hpp"
+#include "LinkStatistics.hpp"
+#include "ResponseParser.hpp"
 
-using namespace std;
+#define JOB_LOOKAHEAD 1000  // default number of queued commands read ahead from a job file
+#define TIMEOUT_OK 10.0  // default seconds without an answer until a command is stalled
+#define TIMEOUT_TEMPERATURE 5.0  // the same for M105
+#define TIMEOUT_HEATING 300.0  // the same for M109 and M116, temperature reports count as answers
+#define WATCHDOG_RECOVERIES 3  // recoveries of one stall before the job is aborted
+#define WATCHDOG_POLL "M105\n"  // written without line number by RECOVERY_POLL
+#define TEMPERATURE_LATE 1.0  // seconds a temperature report may be late before it is polled while idle
+#define TEMPERATURE_STALE 5  // temperature intervals without a report until it is polled while printing
 
-struct Command
-{
-	string command;
-	double time;
-	int m;
-	int g;
-	double x, y, z, f;
-};
+using namespace std;
 
 enum ComStatus
 {
 	STANDBY=0,
 	WAITING_FOR_OK,
 	WAITING_FOR_TEMP,
-	WAITING_FOR_TEMP_ACHIEVED
+	WAITING_FOR_TEMP_ACHIEVED,
+	COM_STATES
+};
+
+enum StallRecovery
+{
+	RECOVERY_POLL=0,  // send M105, its ok replaces a lost ok and its line end ends a line with a lost line end
+	RECOVERY_RESEND,  // write the last line again, the firmware accepts or rejects it like every line
+	RECOVERY_ABORT,  // clear the queue and the job
+	RECOVERIES
 };
 
 class RepRapHost {
 public:
-	RepRapHost();
+	RepRapHost(boost::asio::io_service* sharedService=NULL, size_t bufferSize=BUFFER_SIZE);
 	virtual ~RepRapHost();
 	
 	void setDebug(bool debug);
 	int connect(string port, int baud);
+	void setIoThreadEnabled(bool enable, int realtimePriority=0);
 	int disconnect();
 	bool isConnected();
+	string getPortName();
 	void clear();
 	
 	void setNextLineNumber(int nextLineNumber);
-	void refreshRemainingTime();
 	double getRemainingTime();
-	Command* addCommand(string command, bool putAtEnd=true, bool removeWhenDouble=false);
+	CommandId addCommand(string command, bool putAtEnd=true, bool removeWhenDouble=false);
+	int findCommand(CommandId id, Command& command);
+	int cancelCommand(CommandId id);
+	void setJob(GCodeFile* file, int lookahead=JOB_LOOKAHEAD);
+	void setJob(JobCache* cache, int lookahead=JOB_LOOKAHEAD);
+	double getJobProgress();
 	
 	double getX();
 	double getY();
@@ -64,12 +87,43 @@ public:
 	double getF();
 	
 	double getTempExtruder();
+	double getTempExtruder(int extruder);
+	int getExtruderCount();
 	double getTempBed();
+	void setTemperatureInterval(double seconds, bool autoReport=true);
+	double getTemperatureAge();
+	long getTemperaturePolls();
 	
 	void timerTick(); // This function must be called frequently
+	void service();
+	bool isIdle();
+	int getPortHandle();
+	long getPortEvents();
 	
 	void setHashEnabled(bool enable);
 	bool getHashEnabled();
+	
+	void setStreamingEnabled(bool enable);
+	bool getStreamingEnabled();
+	void setMachineLimits(const MachineLimits& limits);
+	const MachineLimits& getMachineLimits();
+	void setFirmwareBufferSize(int size);
+	int getFirmwareBufferSize();
+	long getLinesSent();
+	void setBinaryProtocol(int version);
+	int getBinaryProtocol();
+	long getBinaryLinesSent();
+	long getResends();
+	long getChecksumErrors();
+	void setTimeout(ComStatus state, double seconds);
+	double getTimeout(ComStatus state);
+	void setStallRecovery(StallRecovery recovery);
+	StallRecovery getStallRecovery();
+	long getStalls();
+	long getRecoveries(StallRecovery recovery);
+	LinkStatistics getStatistics();
+	void clearStatistics();
+	void setStatisticsExport(double seconds, string fileName="");
 	string getHash(string cmd);
 	
 	string toLower(string str);
@@ -78,29 +132,124 @@ public:
 	string double2String(double value);
 	double string2Double(string value);
 	
-	iostream& enableConsoleStream();
-	void disableConsoleStream();
+	ConsoleTap& enableConsoleTap();
+	void disableConsoleTap();
 	
 	int commandsLeft();
 	void getXYZF(double& x, double& y, double& z, double& f);
 	
 protected:
+	Command sendNextCommand();
+	Command takeNextCommand();
+	CommandId queueCommand(Command command, bool putAtEnd=true);
+	string encodeCommand(const string& command, bool& binary);
+	int getLineNumber(const string& command);
+	void lineWritten(const string& line);
+	int takeResendLines(vector<string>& lines, bool window);
+	bool onReceived();
+	void readResponses();
+	virtual void onOk(const FirmwareResponse& response);
+	bool takePollOk(const FirmwareResponse& response);
+	virtual void onResend(const FirmwareResponse& response);
+	virtual void onError(const FirmwareResponse& response);
+	virtual void onBusy(const FirmwareResponse& response);
+	virtual void onWait(const FirmwareResponse& response);
+	virtual void onEcho(const FirmwareResponse& response);
+	virtual void onAchieved(const FirmwareResponse& response);
+	virtual void onTemperature(const FirmwareResponse& response);
+	void checkWatchdog();
+	void exportStatistics();
+	void requestTemperatures();
+	virtual void onStall(ComStatus state, StallRecovery recovery);
+	static double now();
+	void refillJob();
+	double getJobTimeUnread();
+	double getJobTimeQueued();
+	static boost::int64_t toMicroseconds(double seconds);
+	static double fromMicroseconds(boost::int64_t microseconds);
+	bool streamCommands();
+	void resetStreaming();
+	
+	boost::recursive_mutex hostMutex;  // taken by the public methods and the I/O thread, see onReceived()
     ComStatus comStatus;
     BoostComPort comPort;
-	vector<Command> commands;
-	double remainingTime;
+	GCodeParser parser;
+	CommandQueue commands;
+	boost::int64_t queuedTime;  // calculated time of the queued commands in microseconds
 	
-	double tempExtruder;
+	// job file or cache, read ahead while commands are sent
+	GCodeFile* job;
+	JobCache* jobCache;
+	int jobLookahead;
+	double jobTimeRead;  // calculated time of all commands read from the job file
+	double jobTimeDone;  // calculated time of the job up to the end of the last sent command
+	
+	string responseLine;  // the response being handled, its memory is reused
+	double tempExtruder;  // T:, the active extruder
 	double tempBed;
-	boost::regex tempExpression;
+	double tempExtruders[RESPONSE_EXTRUDERS];  // T0:, T1:, ...
+	int extruderCount;
 	
 	int nextLineNumber;
+	int encodedLineNumber;  // of the last line returned by encodeCommand()
+	long linesSent;
+	long binaryLinesSent;
+	
+	// resends
+	LineHistory history;  // lines as written, by line number
+	long resendNext;  // next line to write again, -1 if there is no resend request
+	long ignoreResends;  // resend requests of lines which were in flight behind a rejected line
+	int skipOks;  // ok answers of rejected lines still to come when not streaming
+	long resends;
+	long checksumErrors;
+	
+	// temperature monitoring
+	double temperatureInterval;  // seconds between temperature updates, 0=no monitoring
+	bool autoReport;  // ask the firmware to report temperatures with M155
+	bool autoReportRequested;
+	double lastTemperature;  // time of the last temperature report
+	double lastTemperatureRequest;
+	long temperaturePolls;
+	
+	// statistics
+	LinkStatistics statistics;
+	boost::int64_t sentTime;  // of the last command taken from the queue
+	CommandClass sentClass;
+	double statisticsInterval;  // seconds between exports of the statistics, 0=no export
+	double nextStatisticsExport;
+	string statisticsFileName;  // empty to export to cout
+	
+	// watchdog
+	double timeouts[COM_STATES];  // by state, streaming uses the one of WAITING_FOR_OK, 0=no timeout
+	StallRecovery stallRecovery;
+	double lastProgress;  // time of the last answer or written line
+	int stallRecoveries;  // recoveries since the last ok
+	bool pollInFlight;  // the WATCHDOG_POLL is not acknowledged yet
+	int pollOksBefore;  // ok answers of lines written before the poll which are still to come
+	ResponseType previousResponse;  // type of the last line read from the firmware
+	long stalls;
+	long recoveries[RECOVERIES];
+	
+	// streaming mode
+	struct OutstandingLine
+	{
+		int length;
+		boost::int64_t sent;  // time it was written
+		CommandClass commandClass;  // COMMAND_CLASSES for a resent line which is not measured
+	};
+	
+	deque<OutstandingLine> outstandingLines;  // the lines sent but not acknowledged yet
+	int outstandingBytes;
+	int firmwareFreeLines;  // free command buffer slots of the firmware, -1 if unknown
+	
 	// configuration
 	bool hashEnabled;
 	bool debug;
+	bool streamingEnabled;
+	int firmwareBufferSize;  // size of the receive buffer of the firmware in bytes
+	int binaryProtocol;  // BINARY_PROTOCOL_NONE or the version the firmware understands
 	
 	double hardwareX, hardwareY, hardwareZ, hardwareF;
-	double lastX, lastY, lastZ, lastF, lastE;
 };
 
 #endif /* REPRAPHOST_H_ */
@@ -34,7 +34,6 @@
 #include "RepRapMiniHost.h"
 #include <QFileDialog>
 #include <QFile>
-#include <QTextStream>
 #include <QScrollBar>
 
 RepRapMiniHost::RepRapMiniHost(QWidget *parent)
@@ -44,9 +43,12 @@ RepRapMiniHost::RepRapMiniHost(QWidget *parent)
       y(0.0),
       z(0.0),
       f(0.0),
-      remainingTimeCounter(0),
-      commandsAtExecute(-1),
+      consolePosition(0),
+      cacheThread(NULL),
       boardAnswerTimout(5000),
+      heatingTimeout(300000),
+      stallRecovery(RECOVERY_POLL),
+      stallsShown(0),
       tempReadTime(2000),
       autoRefreshTemperatures(true),
       extrudeWhenMoving(false),
@@ -54,6 +56,14 @@ RepRapMiniHost::RepRapMiniHost(QWidget *parent)
       targetTempBed(120.0),
       debug(true),
       autoOpenPort(false),
+      ioThread(false),
+      ioThreadPriority(0),
+      streaming(false),
+      firmwareBufferSize(63),
+      binaryProtocol(0),
+      jobLookahead(JOB_LOOKAHEAD),
+      jobCacheEnabled(true),
+      eventDriven(true),
       extruderPos(0.0)
 {
 	ui.setupUi(this);
@@ -70,6 +80,7 @@ RepRapMiniHost::RepRapMiniHost(QWidget *parent)
 	tickTimer = new QTimer(this);
 	connect(tickTimer, SIGNAL(timeout()), this, SLOT(onTickTimer()));
 	tickTimer->setInterval(10);
+	serialNotifier=NULL;
 	
 	remainingTimeTimer = new QTimer(this);
 	connect(remainingTimeTimer, SIGNAL(timeout()), this, SLOT(onRemainingTimeTimer()));
@@ -85,9 +96,9 @@ RepRapMiniHost::RepRapMiniHost(QWidget *parent)
 
 	restoreValues();
 	
+	repRapHost.setTemperatureInterval(autoRefreshTemperatures ? tempReadTime/1000.0 : 0.0);
 	if(autoRefreshTemperatures)
 		tempTimer->start();
-	tickTimer->start();
 	remainingTimeTimer->start();
 	if(autoOpenPort)
 		onButtonCom();
@@ -100,6 +111,11 @@ RepRapMiniHost::RepRapMiniHost(QWidget *parent)
 RepRapMiniHost::~RepRapMiniHost()
 {
 	storeValues();
+	if(cacheThread)
+	{
+		cacheThread->join();
+		delete cacheThread;
+	}
 }
 
 void RepRapMiniHost::restoreValues()
@@ -179,6 +195,44 @@ void RepRapMiniHost::restoreValues()
 	
 	autoOpenPort=settings.value("autoOpenPort", false).toBool();
 	ui.checkAutoOpenPort->setChecked(autoOpenPort);
+	
+	ioThread=settings.value("ioThread", ioThread).toBool();
+	ioThreadPriority=settings.value("ioThreadPriority", ioThreadPriority).toInt(&ok);
+	if(!ok)
+		ioThreadPriority=0;
+	repRapHost.setIoThreadEnabled(ioThread, ioThreadPriority);
+	
+	streaming=settings.value("streaming", streaming).toBool();
+	firmwareBufferSize=settings.value("firmwareBufferSize", firmwareBufferSize).toInt(&ok);
+	if(!ok || firmwareBufferSize<=0)
+		firmwareBufferSize=63;
+	repRapHost.setStreamingEnabled(streaming);
+	repRapHost.setFirmwareBufferSize(firmwareBufferSize);
+	
+	binaryProtocol=settings.value("binaryProtocol", binaryProtocol).toInt(&ok);
+	if(!ok || binaryProtocol<BINARY_PROTOCOL_NONE || binaryProtocol>BINARY_PROTOCOL_V2)
+		binaryProtocol=BINARY_PROTOCOL_NONE;
+	repRapHost.setBinaryProtocol(binaryProtocol);
+	
+	jobLookahead=settings.value("jobLookahead", jobLookahead).toInt(&ok);
+	if(!ok || jobLookahead<=0)
+		jobLookahead=JOB_LOOKAHEAD;
+	jobCacheEnabled=settings.value("jobCache", jobCacheEnabled).toBool();
+	
+	eventDriven=settings.value("eventDriven", eventDriven).toBool();
+	
+	boardAnswerTimout=settings.value("boardAnswerTimeout", boardAnswerTimout).toInt(&ok);
+	if(!ok || boardAnswerTimout<0)
+		boardAnswerTimout=5000;
+	heatingTimeout=settings.value("heatingTimeout", heatingTimeout).toInt(&ok);
+	if(!ok || heatingTimeout<0)
+		heatingTimeout=300000;
+	stallRecovery=settings.value("stallRecovery", stallRecovery).toInt(&ok);
+	if(!ok || stallRecovery<RECOVERY_POLL || stallRecovery>RECOVERY_ABORT)
+		stallRecovery=RECOVERY_POLL;
+	repRapHost.setTimeout(WAITING_FOR_OK, boardAnswerTimout/1000.0);
+	repRapHost.setTimeout(WAITING_FOR_TEMP_ACHIEVED, heatingTimeout/1000.0);
+	repRapHost.setStallRecovery((StallRecovery)stallRecovery);
 }
 
 void RepRapMiniHost::storeValues()
@@ -204,17 +258,27 @@ void RepRapMiniHost::storeValues()
 	settings.setValue("fileName", ui.editFile->text());
 	settings.setValue("autoOpenPort", autoOpenPort);
 	settings.setValue("relativeExtruder", ui.checkRelativeExtruder->isChecked());
+	settings.setValue("ioThread", ioThread);
+	settings.setValue("ioThreadPriority", ioThreadPriority);
+	settings.setValue("streaming", streaming);
+	settings.setValue("firmwareBufferSize", firmwareBufferSize);
+	settings.setValue("binaryProtocol", binaryProtocol);
+	settings.setValue("jobLookahead", jobLookahead);
+	settings.setValue("jobCache", jobCacheEnabled);
+	settings.setValue("eventDriven", eventDriven);
+	settings.setValue("boardAnswerTimeout", boardAnswerTimout);
+	settings.setValue("heatingTimeout", heatingTimeout);
+	settings.setValue("stallRecovery", stallRecovery);
 }
 
 /*
- * Add every "tempReadTime" milliseconds a new temperature read
- * command at the top of the command stack.
+ * Show the temperatures every "tempReadTime" milliseconds, the
+ * RepRapHost keeps them up to date (see setTemperatureInterval()).
  */
 void RepRapMiniHost::onTempTimer()
 {
 	if(!repRapHost.isConnected())
 		return;
-	repRapHost.addCommand("M105", false, true);
 	ui.labelTempExtruder->setText(QString::number(repRapHost.getTempExtruder())+trUtf8("°C"));
 	ui.labelTempBed->setText(QString::number(repRapHost.getTempBed())+trUtf8("°C"));
 }
@@ -222,16 +286,85 @@ void RepRapMiniHost::onTempTimer()
 void RepRapMiniHost::onTickTimer()
 {
 	repRapHost.timerTick();
+	checkConnection();
+}
+
+void RepRapMiniHost::onSerialActivity()
+{
+	repRapHost.service();
+	checkConnection();
+}
+
+/*
+ * If the printer closed the connection or the device is gone, the
+ * descriptor stays readable and the serial notifier would fire all the
+ * time, so the port is closed like with the Close button.
+ */
+void RepRapMiniHost::checkConnection()
+{
+	if(repRapHost.isConnected())
+		return;
+	stopServicing();
+	repRapHost.disconnect();
+	ui.buttonCom->setText("Open");
+	statusBar->showMessage(tr("The connection to the printer was closed"), 4000);
+}
+
+/*
+ * Add a command to the RepRapHost and send it right away if the host
+ * is not polled by the tick timer.
+ */
+void RepRapMiniHost::addCommand(string command, bool putAtEnd, bool removeWhenDouble)
+{
+	repRapHost.addCommand(command, putAtEnd, removeWhenDouble);
+	if(serialNotifier)
+		repRapHost.service();
+}
+
+/*
+ * Start to service the RepRapHost after the port is opened.
+ * If the serial port has a file descriptor (not on Windows) the host
+ * is woken up by a QSocketNotifier when data arrives and by new
+ * commands, so it reacts immediately and does not wake up at all when
+ * there is nothing to do. Otherwise, or with the I/O thread which
+ * takes the data out of the port itself, the tick timer polls the host.
+ */
+void RepRapMiniHost::startServicing()
+{
+	int handle=repRapHost.getPortHandle();
+	if(eventDriven && !ioThread && handle>=0)
+	{
+		serialNotifier=new QSocketNotifier(handle, QSocketNotifier::Read, this);
+		connect(serialNotifier, SIGNAL(activated(int)), this, SLOT(onSerialActivity()));
+		repRapHost.service();
+	}
+	else
+	{
+		tickTimer->start();
+	}
+}
+
+/*
+ * Stop servicing the RepRapHost, must be called before the port is closed.
+ */
+void RepRapMiniHost::stopServicing()
+{
+	tickTimer->stop();
+	delete serialNotifier;
+	serialNotifier=NULL;
 }
 
 void RepRapMiniHost::onRemainingTimeTimer()
 {
-	remainingTimeCounter++;
-	if(remainingTimeCounter>30)
+	// without data the serial notifier does not wake up the host to detect stalls
+	if(serialNotifier)
+		repRapHost.service();
+	if(repRapHost.getStalls()!=stallsShown)
 	{
-		repRapHost.refreshRemainingTime();
-		remainingTimeCounter=0;
+		stallsShown=repRapHost.getStalls();
+		statusBar->showMessage(tr("No answer from the printer: ")+QString::number(stallsShown)+tr(" stalls, ")+QString::number(repRapHost.getRecoveries(RECOVERY_ABORT))+tr(" aborted"), 4000);
 	}
+	
 	int remainingTime=(int)repRapHost.getRemainingTime(); // we don't need millisecond precision for a displayed value ;)
 	int seconds=remainingTime%60;
 	int minutes=(remainingTime/60)%60;
@@ -248,10 +381,11 @@ void RepRapMiniHost::onRemainingTimeTimer()
 	ui.labelLeft->setText(tr("Left: ")+strHours+tr(":")+strMinutes+tr(":")+strSeconds);
 	
 	// refresh progress bar
-	if(commandsAtExecute>0)
+	double progress=repRapHost.getJobProgress();
+	if(progress>=0.0)
 	{
-		ui.progressBar->setMaximum(commandsAtExecute);
-		ui.progressBar->setValue(commandsAtExecute-repRapHost.commandsLeft());
+		ui.progressBar->setMaximum(1000);
+		ui.progressBar->setValue((int)(progress*1000));
 	}
 	
 }
@@ -269,10 +403,13 @@ void RepRapMiniHost::onButtonCom()
 				QMessageBox::critical(this, "Fatal error opening com port", "Unable to open the com port!");
 			return;
 		}
+		startServicing();
+		statusBar->showMessage(tr("Connected to ")+QString::fromStdString(repRapHost.getPortName()), 4000);
 		ui.buttonCom->setText("Close");
 	}
 	else
 	{
+		stopServicing();
 		repRapHost.disconnect();
 		ui.buttonCom->setText("Open");
 	}
@@ -343,7 +480,7 @@ void RepRapMiniHost::onButtonGo()
 	double e=0.0;
 	if(extrudeWhenMoving)
 		e=sqrt(dx*dx+dy*dy+dz*dz);
-	repRapHost.addCommand(string("G1 X")+repRapHost.double2String(x) + " Y"+repRapHost.double2String(y) + " Z"+repRapHost.double2String(z) + " F"+repRapHost.double2String(f) + " E"+repRapHost.double2String(e));
+	addCommand(string("G1 X")+repRapHost.double2String(x) + " Y"+repRapHost.double2String(y) + " Z"+repRapHost.double2String(z) + " F"+repRapHost.double2String(f) + " E"+repRapHost.double2String(e));
 }
 
 int RepRapMiniHost::getXYZF()
@@ -411,37 +548,37 @@ void RepRapMiniHost::addPos(float dx, float dy, float dz, float de, bool autoCal
 		extruderPos=de;
 	}
 	setXYZ();
-	repRapHost.addCommand(string("G1 X")+repRapHost.double2String(x) + string(" Y")+repRapHost.double2String(y) + string(" Z")+repRapHost.double2String(z) + string(" F")+repRapHost.double2String(f) + string(" E")+repRapHost.double2String(de));
+	addCommand(string("G1 X")+repRapHost.double2String(x) + string(" Y")+repRapHost.double2String(y) + string(" Z")+repRapHost.double2String(z) + string(" F")+repRapHost.double2String(f) + string(" E")+repRapHost.double2String(de));
 }
 
 void RepRapMiniHost::onButtonHomeX()
 {
-	repRapHost.addCommand("G28 X0");
-	repRapHost.addCommand("G92 X0");
+	addCommand("G28 X0");
+	addCommand("G92 X0");
 	x=0.0;
 	ui.editX->setText(tr("0"));
 }
 
 void RepRapMiniHost::onButtonHomeY()
 {
-	repRapHost.addCommand("G28 Y0");
-	repRapHost.addCommand("G92 Y0");
+	addCommand("G28 Y0");
+	addCommand("G92 Y0");
 	y=0.0;
 	ui.editY->setText(tr("0"));
 }
 
 void RepRapMiniHost::onButtonHomeZ()
 {
-	repRapHost.addCommand("G28 Z0");
-	repRapHost.addCommand("G92 Z0");
+	addCommand("G28 Z0");
+	addCommand("G92 Z0");
 	z=0.0;
 	ui.editZ->setText(tr("0"));
 }
 
 void RepRapMiniHost::onButtonHomeAll()
 {
-	repRapHost.addCommand("G28");
-	repRapHost.addCommand("G92");
+	addCommand("G28");
+	addCommand("G92");
 	ui.editX->setText(tr("0"));
 	ui.editY->setText(tr("0"));
 	ui.editZ->setText(tr("0"));
@@ -460,11 +597,13 @@ void RepRapMiniHost::onCheckAutoRefreshTemperatures(int status)
 	if(status==Qt::Checked)
 	{
 		autoRefreshTemperatures=true;
+		repRapHost.setTemperatureInterval(tempReadTime/1000.0);
 		tempTimer->start();
 	}
 	else
 	{
 		autoRefreshTemperatures=false;
+		repRapHost.setTemperatureInterval(0.0);
 		tempTimer->stop();
 	}
 }
@@ -502,12 +641,12 @@ void RepRapMiniHost::onButtonTempExtruder()
 		return;
 	if(ui.buttonTempExtruder->text()==tr("Turn on"))
 	{
-		repRapHost.addCommand(string("M104 S")+repRapHost.double2String(targetTempExtruder));
+		addCommand(string("M104 S")+repRapHost.double2String(targetTempExtruder));
 		ui.buttonTempExtruder->setText(tr("Turn off"));
 	}
 	else
 	{
-		repRapHost.addCommand("M104 S0");
+		addCommand("M104 S0");
 		ui.buttonTempExtruder->setText(tr("Turn on"));
 	}
 }
@@ -529,7 +668,7 @@ void RepRapMiniHost::editTempExtruderChanged(QString value)
 		statusBar->showMessage(tr("WARNING: Are you shure you want to heat your nozzle to ")+QString::number(targetTempExtruder)+tr(" degrees???"), 4000);
 	}
 	if(ui.buttonTempExtruder->text()==tr("Turn off"))
-		repRapHost.addCommand(string("M104 S")+repRapHost.int2String(targetTempExtruder));
+		addCommand(string("M104 S")+repRapHost.int2String(targetTempExtruder));
 }
 
 void RepRapMiniHost::onButtonTempBed()
@@ -538,12 +677,12 @@ void RepRapMiniHost::onButtonTempBed()
 		return;
 	if(ui.buttonTempBed->text()==tr("Turn on"))
 	{
-		repRapHost.addCommand(string("M140 S")+repRapHost.double2String(targetTempBed));
+		addCommand(string("M140 S")+repRapHost.double2String(targetTempBed));
 		ui.buttonTempBed->setText(tr("Turn off"));
 	}
 	else
 	{
-		repRapHost.addCommand("M140 S0");
+		addCommand("M140 S0");
 		ui.buttonTempBed->setText(tr("Turn on"));
 	}
 }
@@ -565,7 +704,7 @@ void RepRapMiniHost::editTempBedChanged(QString value)
 		statusBar->showMessage(tr("WARNING: Are you shure you want to heat your bed to ")+QString::number(targetTempBed)+tr(" degrees???"), 4000);
 	}
 	if(ui.buttonTempBed->text()==tr("Turn off"))
-		repRapHost.addCommand(string("M104 S")+repRapHost.int2String(targetTempBed));
+		addCommand(string("M104 S")+repRapHost.int2String(targetTempBed));
 }
 
 void RepRapMiniHost::onButtonBrowse()
@@ -578,41 +717,35 @@ void RepRapMiniHost::onButtonBrowse()
 
 void RepRapMiniHost::onButtonExecute()
 {
-	QFile gCodeFile(ui.editFile->text());
-	if(!gCodeFile.open(QIODevice::ReadOnly | QIODevice::Text))
+	string fileName=QFile::encodeName(ui.editFile->text()).constData();
+	if(jobCacheEnabled && jobCache.open(fileName, repRapHost.getMachineLimits())==0)
+	{
+		if(debug)
+			cout<<"Sending the job cache of "<<fileName<<endl;
+		repRapHost.setJob(&jobCache, jobLookahead);
+		if(serialNotifier)
+			repRapHost.service();
+		return;
+	}
+	if(gCodeFile.open(fileName))
 	{
 		statusBar->showMessage(tr("Unable to open file ")+ui.editFile->text()+": No such file or directory", 4000);
 		cout<<"Unable to open file "<<ui.editFile->text().toStdString()<<": No such file or directory"<<endl;
 		return;
 	}
-	QTextStream stream(&gCodeFile);
-	QString line=stream.readLine(0);
-	while(!line.isNull())
+	// the file is read while it is sent
+	repRapHost.setJob(&gCodeFile, jobLookahead);
+	if(serialNotifier)
+		repRapHost.service();
+	
+	// parse the file in the background, so the next print starts from the cache
+	if(cacheThread && cacheThread->timed_join(boost::posix_time::seconds(0)))
 	{
-		if(line.isEmpty())
-		{
-			line=stream.readLine(0);
-			continue;
-		}
-		
-		int commentPos=line.indexOf(";");
-		if(commentPos>=0)
-		{
-			line=line.left(commentPos);
-			while(line.length() && (line[line.length()-1]==QChar(' ') || line[line.length()-1]==QChar('\t')))
-				line=line.left(line.length()-1);
-			if(line.length()<=2)
-			{
-				line=stream.readLine(0);
-				continue;
-			}
-		}
-		repRapHost.addCommand(line.toStdString());
-		line=stream.readLine(0);
+		delete cacheThread;
+		cacheThread=NULL;
 	}
-	if(debug)
-		cout<<"reading file finished..."<<endl;
-	commandsAtExecute = repRapHost.commandsLeft();
+	if(jobCacheEnabled && cacheThread==NULL)
+		cacheThread=new boost::thread(boost::bind(&JobCache::create, fileName, 0, repRapHost.getMachineLimits()));
 }
 
 void RepRapMiniHost::onButtonStop()
@@ -650,39 +783,26 @@ void RepRapMiniHost::onCheckAutoOpenPort(int value)
 
 void RepRapMiniHost::onConsoleTimer()
 {
-	int read;
 	static QString consoleText=tr("");
-	iostream& stream=repRapHost.enableConsoleStream();
-	do
-	{
-		char buffer[1000];
-		stream.readsome(buffer, 999);
-		read=stream.gcount();
-		if(read>0)
-		{
-			buffer[read]=0;
-			QString strBuffer(buffer);
-			consoleText+=strBuffer;
-			QScrollBar* scroll = ui.editLog->verticalScrollBar();
-			//int oldPos=scroll->sliderPosition();
-			//int oldMaxPos=scroll->maximum();
-			//QTextCursor oldCursor = ui.editLog->textCursor();
-			//if(oldPos==oldMaxPos)
-			//{
-				ui.editLog->setPlainText(consoleText);
-				scroll->setSliderPosition(scroll->maximum());
-			//}
-			//else
-			//	scroll->setSliderPosition(oldPos);
-			//ui.editLog->setTextCursor(oldCursor);
-			//scroll->setSliderPosition(scroll->maximum());
-		}
-	} while(read>0);
+	ConsoleTap& tap=repRapHost.enableConsoleTap();
+	vector<ConsoleRecord> records;
+	boost::uint64_t lost=0;
+	if(!tap.drain(consolePosition, records, lost) && !lost)
+		return;
+	if(lost)
+		consoleText+=tr("\n[")+QString::number((qulonglong)lost)+tr(" console records lost]\n");
+	for(unsigned int i=0; i<records.size(); i++)
+		consoleText+=QString::fromLatin1(records[i].data, records[i].length);
+	if(consoleText.length()>CONSOLE_TEXT_SIZE)
+		consoleText=consoleText.right(CONSOLE_TEXT_SIZE);
+	QScrollBar* scroll = ui.editLog->verticalScrollBar();
+	ui.editLog->setPlainText(consoleText);
+	scroll->setSliderPosition(scroll->maximum());
 }
 
 void RepRapMiniHost::onButtonSend()
 {
-	repRapHost.addCommand(ui.comboCommand->currentText().toStdString());
+	addCommand(ui.comboCommand->currentText().toStdString());
 	if(ui.comboCommand->itemText(0)!=ui.comboCommand->currentText())
 	{
 		ui.comboCommand->insertItem(0, ui.comboCommand->currentText());
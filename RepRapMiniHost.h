@@ -22,15 +22,19 @@
 #include <QMessageBox>
 #include <QString>
 #include <QTimer>
+#include <QSocketNotifier>
 #include <QTime>
 #include <QSettings>
 #include <vector>
 #include <string>
 #include <iostream>
 #include "ui_RepRapMiniHost.h"
+#include <boost/thread.hpp>
 #include "RepRapHost.h"
 #include "ManualCommandFilter.h"
 
+#define CONSOLE_TEXT_SIZE 100000  // characters kept in the console window
+
 using namespace std;
 
 struct OldCommand
@@ -55,6 +59,10 @@ protected:
     void setXYZ();
     int getXYZF();
     void getHostXYZF();
+    void addCommand(string command, bool putAtEnd=true, bool removeWhenDouble=false);
+    void startServicing();
+    void stopServicing();
+    void checkConnection();
     
     double steps;
     RepRapHost repRapHost;
@@ -62,16 +70,22 @@ protected:
     QStatusBar* statusBar;
     QTimer* tempTimer; // Timer for adding temperature read commands
     QTimer* tickTimer; // Timer for the RepRapHost class to poll the I/O
+    QSocketNotifier* serialNotifier; // Wakes up the RepRapHost class when data is received, replaces the tickTimer
     QTimer* remainingTimeTimer;
-    int remainingTimeCounter;
     
     QTimer* consoleTimer;
+    boost::uint64_t consolePosition;  // next record of the console tap to show
     ManualCommandFilter manualCommandFilter;
     
-    int commandsAtExecute;  // Number of commands after the execute command, used to calculate the progress bar
+    GCodeFile gCodeFile;  // the file sent by execute
+    JobCache jobCache;  // or its cache if it is up to date
+    boost::thread* cacheThread;  // creates the cache of the last executed file
     
     //configuration
     int boardAnswerTimout; // timeout for answer of the board in milliseconds, 0=no timeout
+    int heatingTimeout;  // the same while the firmware waits for temperatures with M109 or M116
+    int stallRecovery;  // StallRecovery of a stall detected by the timeouts
+    long stallsShown;  // stalls of the RepRapHost shown in the status bar
     int tempReadTime;   // time in milliseconds between each temperature read
     bool autoRefreshTemperatures;
     bool extrudeWhenMoving;
@@ -79,6 +93,14 @@ protected:
     float targetTempBed;
     bool debug;
     bool autoOpenPort;
+    bool ioThread;  // service the serial port in its own thread
+    int ioThreadPriority;  // real-time priority of the I/O thread, 0=normal scheduling
+    bool streaming;  // keep the receive buffer of the firmware filled instead of waiting for every ok
+    int firmwareBufferSize;  // size of the receive buffer of the firmware in bytes
+    int binaryProtocol;  // version of the binary G-code protocol of the firmware, 0=ASCII only
+    int jobLookahead;  // commands of the G-code file queued at a time
+    bool jobCacheEnabled;  // create job caches and use them to print a file again
+    bool eventDriven;  // service the RepRapHost when data arrives instead of every 10ms
     
     double extruderPos; // position of the extruder when using absolute extruder
     
@@ -88,6 +110,7 @@ private:
 private slots:
 	void onTempTimer();
 	void onTickTimer();
+	void onSerialActivity();
 	void onRemainingTimeTimer();
 	void onButtonCom();
 	void onRadio();
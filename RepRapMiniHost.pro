@@ -4,11 +4,37 @@ QT += core \
     gui
 HEADERS += RepRapHost.h \
     BoostComPort.hpp \
+    RingBuffer.hpp \
+    ConsoleTap.hpp \
+    Transport.hpp \
+    BinaryGCode.hpp \
+    GCodeTokenizer.hpp \
+    TimeEstimator.hpp \
+    CommandQueue.hpp \
+    GCodeFile.hpp \
+    GCodeParser.hpp \
+    JobCache.hpp \
+    LineHistory.hpp \
+    LinkStatistics.hpp \
+    ResponseParser.hpp \
     RepRapMiniHost.h
 SOURCES += RepRapHost.cpp \
     BoostComPort.cpp \
+    RingBuffer.cpp \
+    ConsoleTap.cpp \
+    Transport.cpp \
+    BinaryGCode.cpp \
+    GCodeTokenizer.cpp \
+    TimeEstimator.cpp \
+    CommandQueue.cpp \
+    GCodeFile.cpp \
+    GCodeParser.cpp \
+    JobCache.cpp \
+    LineHistory.cpp \
+    LinkStatistics.cpp \
+    ResponseParser.cpp \
     main.cpp \
     RepRapMiniHost.cpp
 FORMS += RepRapMiniHost.ui
 RESOURCES += 
-LIBS += -lboost_system -lboost_regex
+LIBS += -lboost_system -lboost_thread -lboost_chrono
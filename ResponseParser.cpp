@@ -0,0 +1,227 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ResponseParser.hpp"
+#include "GCodeTokenizer.hpp"
+#include <cstring>
+
+/*
+ * The types of the responses by their prefix, compared without case.
+ * The first matching prefix counts.
+ */
+static const struct
+{
+	const char* prefix;
+	ResponseType type;
+} responseTypes[]=
+{
+	{"ok", RESPONSE_OK},
+	{"t:", RESPONSE_TEMPERATURE},
+	{"t0:", RESPONSE_TEMPERATURE},
+	{"b:", RESPONSE_TEMPERATURE},
+	{"echo:busy:", RESPONSE_BUSY},
+	{"busy:", RESPONSE_BUSY},
+	{"echo:", RESPONSE_ECHO},
+	{"wait", RESPONSE_WAIT},
+	{"error:", RESPONSE_ERROR},
+	{"!!", RESPONSE_ERROR},
+	{"resend:", RESPONSE_RESEND},
+	{"rs ", RESPONSE_RESEND},
+	{NULL, RESPONSE_UNKNOWN}
+};
+
+/*
+ * Classify a response and take its fields. The line end may be part
+ * of the response.
+ * Returns: The type of the response, also stored in response
+ */
+ResponseType ResponseParser::parse(const char* begin, const char* end, FirmwareResponse& response)
+{
+	while(end>begin && (end[-1]=='\n' || end[-1]=='\r' || end[-1]==' '))
+		end--;
+	while(begin<end && *begin==' ')
+		begin++;
+	response.type=RESPONSE_UNKNOWN;
+	response.lineNumber=-1;
+	response.freeLines=-1;
+	response.checksumError=false;
+	response.hasTool=false;
+	response.hasBed=false;
+	response.extruders=0;
+	const char* p=begin;
+	for(int i=0; responseTypes[i].prefix; i++)
+	{
+		if(startsWith(begin, end, responseTypes[i].prefix))
+		{
+			response.type=responseTypes[i].type;
+			p=begin+strlen(responseTypes[i].prefix);
+			break;
+		}
+	}
+	switch(response.type)
+	{
+	case RESPONSE_OK:
+		parseFields(p, end, response);
+		break;
+	case RESPONSE_TEMPERATURE:
+		parseFields(begin, end, response);
+		break;
+	case RESPONSE_ERROR:
+		response.checksumError=contains(p, end, "checksum");
+		break;
+	case RESPONSE_RESEND:
+	{
+		while(p<end && (*p==':' || *p==' ' || *p=='N' || *p=='n'))
+			p++;
+		double value;
+		if(GCodeTokenizer::parseNumber(p, end, value))
+			response.lineNumber=(long)value;
+		break;
+	}
+	case RESPONSE_UNKNOWN:
+		if(contains(begin, end, "achieved"))
+			response.type=RESPONSE_ACHIEVED;
+		break;
+	default:
+		break;
+	}
+	return response.type;
+}
+
+/*
+ * Take the temperatures (T:, B:, T0:, ...) and the fields of an
+ * extended ok (N, B) from a list of fields. Other fields like @:, B@:,
+ * E: and W: are skipped.
+ */
+void ResponseParser::parseFields(const char* p, const char* end, FirmwareResponse& response)
+{
+	while(p<end)
+	{
+		while(p<end && *p==' ')
+			p++;
+		const char* name=p;
+		while(p<end && *p!=' ' && *p!=':')
+			p++;
+		size_t length=p-name;
+		if(length==0)
+		{
+			p++;  // a colon without name
+			continue;
+		}
+		char letter=name[0] & ~0x20;  // upper case
+		if(p<end && *p==':')
+		{
+			double value, target;
+			const char* stop=parseTemperature(p+1, end, value, target);
+			if(stop==NULL)
+				stop=p+1;
+			else if(length==1 && letter=='T')
+			{
+				response.hasTool=true;
+				response.tool=value;
+				response.toolTarget=target;
+			}
+			else if(length==1 && letter=='B')
+			{
+				response.hasBed=true;
+				response.bed=value;
+				response.bedTarget=target;
+			}
+			else if(length==2 && letter=='T' && name[1]>='0' && name[1]<'0'+RESPONSE_EXTRUDERS)
+			{
+				int index=name[1]-'0';
+				for(int i=response.extruders; i<index; i++)
+				{
+					response.extruder[i]=0.0;  // not reported
+					response.extruderTarget[i]=-1.0;
+				}
+				response.extruder[index]=value;
+				response.extruderTarget[index]=target;
+				if(index>=response.extruders)
+					response.extruders=index+1;
+			}
+			p=stop;
+		}
+		else if(response.type==RESPONSE_OK)
+		{
+			double value;
+			const char* number=(letter=='N' || letter=='B') ? name+1 : name;
+			if(GCodeTokenizer::parseNumber(number, p, value)==p)
+			{
+				if(letter=='B')
+					response.freeLines=(int)value;
+				else
+					response.lineNumber=(long)value;  // "ok N10" or "ok 10"
+			}
+		}
+		while(p<end && *p!=' ')
+			p++;
+	}
+}
+
+/*
+ * Parse a temperature with an optional target like "210.0 /215.0".
+ * Returns: The end of the temperature, NULL if there is no number
+ */
+const char* ResponseParser::parseTemperature(const char* p, const char* end, double& value, double& target)
+{
+	target=-1.0;
+	const char* stop=GCodeTokenizer::parseNumber(p, end, value);
+	if(stop==NULL)
+		return NULL;
+	const char* slash=stop;
+	while(slash<end && *slash==' ')
+		slash++;
+	if(slash<end && *slash=='/')
+	{
+		const char* targetEnd=GCodeTokenizer::parseNumber(slash+1, end, target);
+		if(targetEnd)
+			return targetEnd;
+		target=-1.0;
+	}
+	return stop;
+}
+
+/*
+ * Returns: true if the text starts with the lower case prefix, compared
+ *          without case
+ */
+bool ResponseParser::startsWith(const char* begin, const char* end, const char* prefix)
+{
+	for(; *prefix; prefix++, begin++)
+	{
+		if(begin>=end)
+			return false;
+		char c=*begin;
+		if(c>='A' && c<='Z')
+			c+=0x20;
+		if(c!=*prefix)
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Returns: true if the lower case text is found, compared without case
+ */
+bool ResponseParser::contains(const char* begin, const char* end, const char* text)
+{
+	for(; begin<end; begin++)
+		if(startsWith(begin, end, text))
+			return true;
+	return false;
+}
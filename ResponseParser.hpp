@@ -0,0 +1,82 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RESPONSEPARSER_HPP_
+#define RESPONSEPARSER_HPP_
+
+#include <cstddef>
+
+#define RESPONSE_EXTRUDERS 4  // extruders with a temperature of their own (T0: to T3:)
+
+using namespace std;
+
+enum ResponseType
+{
+	RESPONSE_UNKNOWN=0,
+	RESPONSE_OK,  // ok, maybe with temperatures or N.. P.. B..
+	RESPONSE_TEMPERATURE,  // a temperature report without ok
+	RESPONSE_BUSY,  // busy: or echo:busy:, a command takes longer
+	RESPONSE_WAIT,  // wait, the firmware has nothing to do
+	RESPONSE_ECHO,  // echo: and the message
+	RESPONSE_ERROR,  // Error: or !! and the message
+	RESPONSE_RESEND,  // Resend: or rs and the line number
+	RESPONSE_ACHIEVED  // the heaters achieved their target temperature
+};
+
+/*
+ * A response of the firmware, see ResponseParser. Temperatures are
+ * only valid if their flag is set, targets which are not reported are
+ * -1.0.
+ */
+struct FirmwareResponse
+{
+	ResponseType type;
+	long lineNumber;  // of Resend: or of an ok N.., -1 if there is none
+	int freeLines;  // free command buffer slots of an ok B.., -1 if unknown
+	bool checksumError;  // an Error: about a checksum
+	bool hasTool;
+	double tool, toolTarget;  // T:, the active extruder
+	bool hasBed;
+	double bed, bedTarget;  // B:
+	int extruders;  // number of extruders with T0:, T1:, ..., 0 if there are none
+	double extruder[RESPONSE_EXTRUDERS];
+	double extruderTarget[RESPONSE_EXTRUDERS];
+};
+
+/*
+ * ResponseParser classifies a response line of the firmware in one
+ * pass over its characters, without regular expressions and without
+ * allocating memory. The type is found by the prefix in a table, ok
+ * and temperature reports are then scanned for their fields:
+ * "ok", "ok N10 P15 B3", "ok T:210.0 /210.0 B:60.0 /60.0 @:0 B@:0",
+ * "T:20.0 /0.0 B:20.0 /0.0 T0:20.0 /0.0 T1:20.0 /0.0", "T:205.3 E:0 W:?",
+ * "echo:busy: processing", "wait", "Error:checksum mismatch",
+ * "Resend: 12", "rs 12" and "Temperature achieved".
+ */
+class ResponseParser
+{
+public:
+	static ResponseType parse(const char* begin, const char* end, FirmwareResponse& response);
+
+private:
+	static void parseFields(const char* p, const char* end, FirmwareResponse& response);
+	static const char* parseTemperature(const char* p, const char* end, double& value, double& target);
+	static bool startsWith(const char* begin, const char* end, const char* prefix);
+	static bool contains(const char* begin, const char* end, const char* text);
+};
+
+#endif /* RESPONSEPARSER_HPP_ */
@@ -0,0 +1,244 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "RingBuffer.hpp"
+#include <cstring>
+
+RingBuffer::RingBuffer(size_t capacity):
+bufferSize(capacity),
+readPos(0),
+content(0)
+{
+	data=new char[bufferSize];
+}
+
+RingBuffer::~RingBuffer()
+{
+	delete[] data;
+}
+
+size_t RingBuffer::size() const
+{
+	return content;
+}
+
+size_t RingBuffer::capacity() const
+{
+	return bufferSize;
+}
+
+size_t RingBuffer::freeSpace() const
+{
+	return bufferSize-content;
+}
+
+bool RingBuffer::isEmpty() const
+{
+	return content==0;
+}
+
+bool RingBuffer::isFull() const
+{
+	return content==bufferSize;
+}
+
+/*
+ * Drop all data in the ring. The read position is reset as well so
+ * the next write gets the largest possible contiguous block. This
+ * must not be called while a write is running, use consume(size())
+ * in that case.
+ */
+void RingBuffer::clear()
+{
+	readPos=0;
+	content=0;
+}
+
+/*
+ * Get the position where the next data has to be written to.
+ * contiguous is set to the number of bytes which can be written
+ * there without wrapping around. It is 0 if the ring is full.
+ */
+char* RingBuffer::writePointer(size_t& contiguous)
+{
+	size_t writePos=readPos+content;
+	if(writePos>=bufferSize)
+		writePos-=bufferSize;
+	if(writePos<readPos || content==bufferSize)
+		contiguous=readPos-writePos;
+	else
+		contiguous=bufferSize-writePos;
+	return data+writePos;
+}
+
+/*
+ * Publish length bytes which have been written to the location
+ * returned by writePointer().
+ */
+void RingBuffer::commitWrite(size_t length)
+{
+	if(length>freeSpace())
+		length=freeSpace();
+	content+=length;
+}
+
+/*
+ * Copy data into the ring.
+ * Returns: The number of bytes written, less than length if the
+ *          ring is full
+ */
+size_t RingBuffer::write(const char* source, size_t length)
+{
+	size_t written=0;
+	while(written<length)
+	{
+		size_t contiguous;
+		char* target=writePointer(contiguous);
+		if(contiguous==0)
+			break;
+		if(contiguous>length-written)
+			contiguous=length-written;
+		memcpy(target, source+written, contiguous);
+		commitWrite(contiguous);
+		written+=contiguous;
+	}
+	return written;
+}
+
+/*
+ * Copy up to length bytes starting offset bytes behind the read
+ * position without removing them from the ring.
+ * Returns: The number of bytes copied
+ */
+size_t RingBuffer::peek(char* target, size_t length, size_t offset) const
+{
+	if(offset>=content)
+		return 0;
+	if(length>content-offset)
+		length=content-offset;
+	size_t copied=0;
+	while(copied<length)
+	{
+		size_t contiguous;
+		const char* source=readPointer(offset+copied, contiguous);
+		if(contiguous>length-copied)
+			contiguous=length-copied;
+		memcpy(target+copied, source, contiguous);
+		copied+=contiguous;
+	}
+	return copied;
+}
+
+char RingBuffer::at(size_t offset) const
+{
+	size_t pos=readPos+offset;
+	if(pos>=bufferSize)
+		pos-=bufferSize;
+	return data[pos];
+}
+
+/*
+ * Get a pointer to the data offset bytes behind the read position.
+ * contiguous is set to the number of valid bytes at that pointer
+ * before the ring wraps around.
+ */
+const char* RingBuffer::readPointer(size_t offset, size_t& contiguous) const
+{
+	if(offset>=content)
+	{
+		contiguous=0;
+		return data;
+	}
+	size_t pos=readPos+offset;
+	if(pos>=bufferSize)
+		pos-=bufferSize;
+	contiguous=content-offset;
+	if(pos+contiguous>bufferSize)
+		contiguous=bufferSize-pos;
+	return data+pos;
+}
+
+/*
+ * Remove length bytes from the front of the ring. This only moves
+ * the read position, no data is copied. The write position is never
+ * touched, so it is safe to consume while a write into the location
+ * returned by writePointer() is still running.
+ */
+void RingBuffer::consume(size_t length)
+{
+	if(length>content)
+		length=content;
+	readPos+=length;
+	if(readPos>=bufferSize)
+		readPos-=bufferSize;
+	content-=length;
+}
+
+size_t RingBuffer::read(char* target, size_t length)
+{
+	size_t copied=peek(target, length);
+	consume(copied);
+	return copied;
+}
+
+/*
+ * Search for a sequence of bytes, starting from offset bytes behind
+ * the read position.
+ * The first byte is searched with memchr on the contiguous parts of
+ * the ring, the rest of the sequence is only compared at candidates.
+ * Returns: The offset of the first match or -1 if not found
+ */
+long RingBuffer::find(const char* searchValue, size_t searchSize, size_t from) const
+{
+	if(searchSize==0 || searchSize>content)
+		return -1;
+	size_t last=content-searchSize;  // last possible start of a match
+	size_t start=from;
+	while(start<=last)
+	{
+		size_t contiguous;
+		const char* segment=readPointer(start, contiguous);
+		if(contiguous>last-start+1)
+			contiguous=last-start+1;
+		const char* candidate=(const char*)memchr(segment, searchValue[0], contiguous);
+		if(candidate==NULL)
+		{
+			start+=contiguous;
+			continue;
+		}
+		start+=candidate-segment;
+		if(searchSize==1 || matches(start, searchValue, searchSize))
+			return (long)start;
+		start++;
+	}
+	return -1;
+}
+
+/*
+ * Compare the data offset bytes behind the read position with
+ * searchValue, also if it wraps around the end of the ring.
+ */
+bool RingBuffer::matches(size_t offset, const char* searchValue, size_t searchSize) const
+{
+	size_t contiguous;
+	const char* segment=readPointer(offset, contiguous);
+	if(contiguous>=searchSize)
+		return memcmp(segment, searchValue, searchSize)==0;
+	if(memcmp(segment, searchValue, contiguous)!=0)
+		return false;
+	return matches(offset+contiguous, searchValue+contiguous, searchSize-contiguous);
+}
@@ -0,0 +1,69 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RINGBUFFER_HPP_
+#define RINGBUFFER_HPP_
+
+#include <cstddef>
+
+/*
+ * RingBuffer is a fixed size byte ring used as receive buffer of
+ * the BoostComPort class.
+ * The writer asks for the free contiguous space with writePointer(),
+ * lets the data land there (for example by an asynchronous read of
+ * boost) and publishes it with commitWrite(). The reader copies data
+ * out with peek() and drops it with consume(), which only advances the
+ * read position. Nothing is ever moved inside the ring.
+ */
+class RingBuffer
+{
+public:
+	RingBuffer(size_t capacity);
+	~RingBuffer();
+
+	size_t size() const;
+	size_t capacity() const;
+	size_t freeSpace() const;
+	bool isEmpty() const;
+	bool isFull() const;
+	void clear();
+
+	char* writePointer(size_t& contiguous);
+	void commitWrite(size_t length);
+	size_t write(const char* data, size_t length);
+
+	size_t peek(char* data, size_t length, size_t offset=0) const;
+	char at(size_t offset) const;
+	const char* readPointer(size_t offset, size_t& contiguous) const;
+	void consume(size_t length);
+	size_t read(char* data, size_t length);
+
+	long find(const char* searchValue, size_t searchSize, size_t from=0) const;
+
+private:
+	bool matches(size_t offset, const char* searchValue, size_t searchSize) const;
+
+	RingBuffer(const RingBuffer&);
+	RingBuffer& operator=(const RingBuffer&);
+
+	char* data;
+	size_t bufferSize;
+	size_t readPos;
+	size_t content;
+};
+
+#endif /* RINGBUFFER_HPP_ */
@@ -0,0 +1,307 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TimeEstimator.hpp"
+#include <cmath>
+#include <algorithm>
+
+#define MIN_MOVE_LENGTH 0.000001  // mm, shorter moves are dropped like by the firmware
+
+MachineLimits::MachineLimits():
+junctionDeviation(0.013),
+lookahead(16)
+{
+	maxFeedrate[0]=300.0;
+	maxFeedrate[1]=300.0;
+	maxFeedrate[2]=5.0;
+	maxFeedrate[3]=25.0;
+	maxAcceleration[0]=3000.0;
+	maxAcceleration[1]=3000.0;
+	maxAcceleration[2]=100.0;
+	maxAcceleration[3]=10000.0;
+	heatingRate[ESTIMATOR_HEATER_EXTRUDER]=2.0;
+	heatingRate[ESTIMATOR_HEATER_BED]=0.8;
+}
+
+TimeEstimator::TimeEstimator()
+{
+	reset();
+}
+
+/*
+ * Set the limits of the printer, the moves planned so far are kept.
+ */
+void TimeEstimator::setLimits(const MachineLimits& limits)
+{
+	this->limits=limits;
+	if(this->limits.lookahead<1)
+		this->limits.lookahead=1;
+}
+
+const MachineLimits& TimeEstimator::getLimits() const
+{
+	return limits;
+}
+
+/*
+ * Forget the planned moves and let the heaters cool down, like at the
+ * start of a job.
+ */
+void TimeEstimator::reset()
+{
+	blocks.clear();
+	planned=0.0;
+	for(int i=0; i<ESTIMATOR_HEATERS; i++)
+	{
+		temperature[i]=ESTIMATOR_ROOM_TEMPERATURE;
+		target[i]=ESTIMATOR_ROOM_TEMPERATURE;
+	}
+}
+
+/*
+ * Add a move by delta (mm for X, Y, Z and E) with the feedrate in
+ * mm/min. length is the length of the path if it is not straight
+ * (arcs), 0.0 for straight moves. Moves without X, Y and Z are as
+ * long as their E part.
+ * Returns: The time the move adds to the job in seconds
+ */
+double TimeEstimator::move(const double delta[ESTIMATOR_AXES], double feedrate, double length)
+{
+	double xyz=sqrt(delta[0]*delta[0]+delta[1]*delta[1]+delta[2]*delta[2]);
+	if(length<=0.0)
+		length=xyz>0.0 ? xyz : fabs(delta[3]);
+	if(length<MIN_MOVE_LENGTH || feedrate<=0.0)
+		return 0.0;
+
+	Block block;
+	double norm=sqrt(xyz*xyz+delta[3]*delta[3]);
+	for(int i=0; i<ESTIMATOR_AXES; i++)
+		block.unit[i]=norm>0.0 ? delta[i]/norm : 0.0;
+	block.length=length;
+	block.nominalSpeed=feedrate/60.0;
+	block.acceleration=HUGE_VAL;
+	for(int i=0; i<ESTIMATOR_AXES; i++)
+	{
+		if(delta[i]==0.0)
+			continue;
+		// the axis moves this part of the length of the move
+		double part=fabs(delta[i])/length;
+		if(block.nominalSpeed*part>limits.maxFeedrate[i])
+			block.nominalSpeed=limits.maxFeedrate[i]/part;
+		if(block.acceleration*part>limits.maxAcceleration[i])
+			block.acceleration=limits.maxAcceleration[i]/part;
+	}
+	if(block.acceleration==HUGE_VAL)
+	{
+		// a full circle ends where it started
+		block.nominalSpeed=min(block.nominalSpeed, limits.maxFeedrate[0]);
+		block.acceleration=limits.maxAcceleration[0];
+	}
+	block.maxEntrySpeed=blocks.empty() ? 0.0 : junctionSpeed(blocks.back(), block);
+	block.reverseSpeed=block.maxEntrySpeed;
+	block.entrySpeed=0.0;
+	block.time=0.0;
+
+	double before=planned;
+	blocks.push_back(block);
+	plan();
+	double executed=0.0;
+	while((int)blocks.size()>limits.lookahead)
+	{
+		// the oldest move is executed, its exit speed can not change any more
+		executed+=blocks.front().time;
+		blocks.pop_front();
+	}
+	planned=plannedTime();
+	double time=executed+planned-before;
+	heat(time);
+	return time;
+}
+
+/*
+ * Wait after all planned moves (G4).
+ * Returns: The time the dwell adds to the job in seconds
+ */
+double TimeEstimator::dwell(double seconds)
+{
+	synchronize();
+	if(seconds<0.0)
+		seconds=0.0;
+	heat(seconds);
+	return seconds;
+}
+
+/*
+ * Finish all planned moves, the next move starts from standstill. The
+ * time of the planned moves is already counted.
+ */
+void TimeEstimator::synchronize()
+{
+	blocks.clear();
+	planned=0.0;
+}
+
+/*
+ * Set the target of a heater, with wait after the planned moves until
+ * the heater has heated up to it (M109, M190). Cooling down is not
+ * waited for.
+ * Returns: The time the command adds to the job in seconds
+ */
+double TimeEstimator::setTemperature(int heater, double target, bool wait)
+{
+	if(heater<0 || heater>=ESTIMATOR_HEATERS)
+		return 0.0;
+	this->target[heater]=target;
+	if(!wait)
+		return 0.0;
+	synchronize();
+	if(temperature[heater]>=target || limits.heatingRate[heater]<=0.0)
+		return 0.0;
+	double time=(target-temperature[heater])/limits.heatingRate[heater];
+	heat(time);
+	temperature[heater]=target;
+	return time;
+}
+
+bool TimeEstimator::operator==(const TimeEstimator& other) const
+{
+	if(blocks.size()!=other.blocks.size() || planned!=other.planned)
+		return false;
+	for(int i=0; i<ESTIMATOR_HEATERS; i++)
+		if(temperature[i]!=other.temperature[i] || target[i]!=other.target[i])
+			return false;
+	for(size_t i=0; i<blocks.size(); i++)
+	{
+		const Block& a=blocks[i];
+		const Block& b=other.blocks[i];
+		if(a.length!=b.length || a.nominalSpeed!=b.nominalSpeed || a.acceleration!=b.acceleration ||
+			a.maxEntrySpeed!=b.maxEntrySpeed || a.reverseSpeed!=b.reverseSpeed ||
+			a.entrySpeed!=b.entrySpeed || a.time!=b.time)
+			return false;
+		for(int j=0; j<ESTIMATOR_AXES; j++)
+			if(a.unit[j]!=b.unit[j])
+				return false;
+	}
+	return true;
+}
+
+/*
+ * Calculate the entry speeds of the planned moves after a move was
+ * added. The last move ends at standstill, every move must be able to
+ * decelerate to the entry speed of the next one (reverse pass) and to
+ * accelerate to it from its own entry speed (forward pass). The entry
+ * speed of the first move is final. The reverse pass stops at the
+ * first move whose speed does not change, the moves before it do not
+ * change either.
+ */
+void TimeEstimator::plan()
+{
+	size_t last=blocks.size()-1;
+	size_t changed=last;
+	double exitSpeed=0.0;
+	for(size_t i=last; i>0; i--)
+	{
+		Block& block=blocks[i];
+		double speed=min(block.maxEntrySpeed, sqrt(exitSpeed*exitSpeed+2.0*block.acceleration*block.length));
+		if(i<last && speed==block.reverseSpeed)
+			break;
+		block.reverseSpeed=speed;
+		changed=i;
+		exitSpeed=speed;
+	}
+	for(size_t i=changed; i<=last; i++)
+	{
+		Block& block=blocks[i];
+		block.entrySpeed=block.reverseSpeed;
+		if(i>0)
+		{
+			const Block& previous=blocks[i-1];
+			double reachable=sqrt(previous.entrySpeed*previous.entrySpeed+2.0*previous.acceleration*previous.length);
+			if(block.entrySpeed>reachable)
+				block.entrySpeed=reachable;
+		}
+	}
+	for(size_t i=changed>0 ? changed-1 : 0; i<=last; i++)
+		blocks[i].time=blockTime(blocks[i], i<last ? blocks[i+1].entrySpeed : 0.0);
+}
+
+/*
+ * Returns: The highest speed at the junction of two moves, the
+ *          junction deviation model of Marlin and grbl
+ */
+double TimeEstimator::junctionSpeed(const Block& previous, const Block& block) const
+{
+	double cosTheta=0.0;
+	for(int i=0; i<ESTIMATOR_AXES; i++)
+		cosTheta-=previous.unit[i]*block.unit[i];
+	double limit=min(previous.nominalSpeed, block.nominalSpeed);
+	if(cosTheta>0.999999)
+		return 0.0;  // the direction is reversed
+	if(cosTheta<-0.999999)
+		return limit;  // straight on
+	double sinHalfTheta=sqrt(0.5*(1.0-cosTheta));
+	double speed=sqrt(block.acceleration*limits.junctionDeviation*sinHalfTheta/(1.0-sinHalfTheta));
+	return min(speed, limit);
+}
+
+/*
+ * Returns: The time of the planned moves up to standstill
+ */
+double TimeEstimator::plannedTime() const
+{
+	double time=0.0;
+	for(size_t i=0; i<blocks.size(); i++)
+		time+=blocks[i].time;
+	return time;
+}
+
+/*
+ * Returns: The time of a move on its trapezoid velocity profile
+ */
+double TimeEstimator::blockTime(const Block& block, double exitSpeed)
+{
+	double a=block.acceleration;
+	double v0=block.entrySpeed;
+	double v1=exitSpeed;
+	double nominal=block.nominalSpeed;
+	double accelerationLength=(nominal*nominal-v0*v0)/(2.0*a);
+	double decelerationLength=(nominal*nominal-v1*v1)/(2.0*a);
+	if(accelerationLength+decelerationLength<=block.length)
+		return (nominal-v0)/a+(nominal-v1)/a+(block.length-accelerationLength-decelerationLength)/nominal;
+	// the nominal speed is not reached, the profile is a triangle
+	double peak=sqrt(a*block.length+0.5*(v0*v0+v1*v1));
+	if(peak<v0 || peak<v1)
+		return 2.0*block.length/(v0+v1);
+	return (peak-v0)/a+(peak-v1)/a;
+}
+
+/*
+ * Let the heaters approach their targets for some time.
+ */
+void TimeEstimator::heat(double seconds)
+{
+	if(seconds<=0.0)
+		return;
+	for(int i=0; i<ESTIMATOR_HEATERS; i++)
+	{
+		double change=limits.heatingRate[i]*seconds;
+		if(temperature[i]<target[i])
+			temperature[i]=min(target[i], temperature[i]+change);
+		else if(temperature[i]>target[i])
+			temperature[i]=max(target[i], temperature[i]-change);
+	}
+}
@@ -0,0 +1,105 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TIMEESTIMATOR_HPP_
+#define TIMEESTIMATOR_HPP_
+
+#include <deque>
+
+#define ESTIMATOR_AXES 4  // X Y Z E
+#define ESTIMATOR_HEATERS 2  // extruder, bed
+#define ESTIMATOR_HEATER_EXTRUDER 0
+#define ESTIMATOR_HEATER_BED 1
+#define ESTIMATOR_ROOM_TEMPERATURE 20.0
+
+using namespace std;
+
+/*
+ * The limits of the printer used by the TimeEstimator. The defaults
+ * are those of a common Marlin configuration.
+ */
+struct MachineLimits
+{
+	double maxFeedrate[ESTIMATOR_AXES];  // mm/s
+	double maxAcceleration[ESTIMATOR_AXES];  // mm/s^2
+	double junctionDeviation;  // mm
+	double heatingRate[ESTIMATOR_HEATERS];  // degrees per second
+	int lookahead;  // moves planned together, the planner buffer of the firmware
+
+	MachineLimits();
+};
+
+/*
+ * TimeEstimator calculates the time of the moves like the planner of
+ * the firmware: every move accelerates and decelerates on a trapezoid
+ * velocity profile, the speed at the junction of two moves is limited
+ * by the angle between them (junction deviation). The last lookahead
+ * moves are planned together, assuming the printer stops after the
+ * last one; older moves are final. Like in the firmware, only the
+ * moves whose speeds change are planned again, so adding a move
+ * usually takes constant time.
+ * Every method returns the time the command adds to the whole job, so
+ * the time of a move also contains the time the moves before it save
+ * because they do not have to stop any more. The sum of these times
+ * is the time of the job, and every command gets its time as soon as
+ * it is added.
+ * Heaters heat or cool at a constant rate towards their target while
+ * the commands are executed.
+ */
+class TimeEstimator
+{
+public:
+	TimeEstimator();
+
+	void setLimits(const MachineLimits& limits);
+	const MachineLimits& getLimits() const;
+	void reset();
+
+	double move(const double delta[ESTIMATOR_AXES], double feedrate, double length=0.0);
+	double dwell(double seconds);
+	void synchronize();
+	double setTemperature(int heater, double target, bool wait);
+
+	bool operator==(const TimeEstimator& other) const;
+
+private:
+	struct Block
+	{
+		double length;  // mm
+		double unit[ESTIMATOR_AXES];  // direction of the move
+		double nominalSpeed;  // mm/s
+		double acceleration;  // mm/s^2
+		double maxEntrySpeed;
+		double reverseSpeed;  // entry speed from which the printer can stop in time
+		double entrySpeed;
+		double time;  // with the current entry and exit speed
+	};
+
+	void plan();
+	double junctionSpeed(const Block& previous, const Block& block) const;
+	double plannedTime() const;
+	static double blockTime(const Block& block, double exitSpeed);
+	void heat(double seconds);
+
+	MachineLimits limits;
+	deque<Block> blocks;  // the planned moves, the entry speed of the first one is final
+	double planned;  // time of the planned moves
+	double temperature[ESTIMATOR_HEATERS];
+	double target[ESTIMATOR_HEATERS];
+};
+
+#endif /* TIMEESTIMATOR_HPP_ */
@@ -0,0 +1,320 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Transport.hpp"
+#include <iostream>
+#include <cstdlib>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#endif
+
+Transport::~Transport()
+{
+
+}
+
+/*
+ * Returns: The file descriptor of the connection, -1 if there is none
+ */
+int Transport::getNativeHandle()
+{
+	return -1;
+}
+
+/*
+ * Create a transport from an URI, see Transport.hpp for the supported
+ * schemes. A baud parameter in the URI overrides the given baud rate.
+ * Returns: The new (not yet opened) transport or NULL if the URI is
+ *          not understood
+ */
+Transport* Transport::create(string uri, int baud, boost::asio::io_service& io_service)
+{
+	size_t pos=uri.find("://");
+	if(pos==string::npos)
+		return new SerialTransport(io_service, uri, baud);
+	string scheme=uri.substr(0, pos);
+	string path=uri.substr(pos+3);
+	pos=path.find('?');
+	if(pos!=string::npos)
+	{
+		string query=path.substr(pos+1);
+		path=path.substr(0, pos);
+		while(query.length())
+		{
+			pos=query.find('&');
+			string parameter=query.substr(0, pos);
+			if(parameter.compare(0, 5, "baud=")==0)
+				baud=atoi(parameter.c_str()+5);
+			else
+				cerr<<"Transport::create(): Unknown parameter "<<parameter<<endl;
+			if(pos==string::npos)
+				break;
+			query=query.substr(pos+1);
+		}
+	}
+	if(scheme=="serial")
+		return new SerialTransport(io_service, path, baud);
+	if(scheme=="tcp")
+	{
+		if(path.length() && path[path.length()-1]=='/')
+			path=path.substr(0, path.length()-1);
+		pos=path.rfind(':');
+		if(pos==string::npos)
+		{
+			cerr<<"Transport::create(): No port given in "<<uri<<endl;
+			return NULL;
+		}
+		return new TcpTransport(io_service, path.substr(0, pos), path.substr(pos+1));
+	}
+#ifndef _WIN32
+	if(scheme=="pty")
+		return new PtyTransport(io_service, path);
+#endif
+	cerr<<"Transport::create(): Unknown scheme "<<scheme<<endl;
+	return NULL;
+}
+
+SerialTransport::SerialTransport(boost::asio::io_service& io_service, string device, int baud):
+serialPort(io_service),
+device(device),
+baud(baud)
+{
+
+}
+
+int SerialTransport::open()
+{
+	try
+	{
+		serialPort.open(device);
+		boost::asio::serial_port_base::baud_rate baudRate(baud);
+		serialPort.set_option(baudRate);
+		return 0;
+	}
+	catch(...)
+	{
+		return -1;
+	}
+}
+
+void SerialTransport::close(boost::system::error_code& error)
+{
+	serialPort.close(error);
+}
+
+bool SerialTransport::isOpen()
+{
+	return serialPort.is_open();
+}
+
+void SerialTransport::asyncReadSome(char* data, size_t length, ReadHandler handler)
+{
+	serialPort.async_read_some(boost::asio::buffer(data, length), handler);
+}
+
+size_t SerialTransport::write(const vector<boost::asio::const_buffer>& buffers, boost::system::error_code& error)
+{
+	return boost::asio::write(serialPort, buffers, boost::asio::transfer_all(), error);
+}
+
+int SerialTransport::getNativeHandle()
+{
+#ifdef _WIN32
+	return -1;
+#else
+	if(!serialPort.is_open())
+		return -1;
+	return serialPort.native_handle();
+#endif
+}
+
+string SerialTransport::getName()
+{
+	return device;
+}
+
+TcpTransport::TcpTransport(boost::asio::io_service& io_service, string host, string port):
+io_service(io_service),
+socket(io_service),
+host(host),
+port(port)
+{
+
+}
+
+/*
+ * Connects to the first address of the host which accepts the
+ * connection. Nagle's algorithm is turned off, every command has to
+ * go out immediately.
+ */
+int TcpTransport::open()
+{
+	boost::system::error_code error;
+	boost::asio::ip::tcp::resolver resolver(io_service);
+	boost::asio::ip::tcp::resolver::query query(host, port);
+	boost::asio::ip::tcp::resolver::iterator endpoint=resolver.resolve(query, error);
+	if(error)
+	{
+		cerr<<"TcpTransport::open(): Unable to resolve "<<host<<": "<<error.message()<<endl;
+		return -1;
+	}
+	error=boost::asio::error::host_not_found;  // if there is no address at all
+	for(; endpoint!=boost::asio::ip::tcp::resolver::iterator(); endpoint++)
+	{
+		socket.close(error);
+		socket.connect(*endpoint, error);
+		if(!error)
+			break;
+	}
+	if(error)
+	{
+		cerr<<"TcpTransport::open(): Unable to connect to "<<getName()<<": "<<error.message()<<endl;
+		return -1;
+	}
+	socket.set_option(boost::asio::ip::tcp::no_delay(true), error);
+	return 0;
+}
+
+void TcpTransport::close(boost::system::error_code& error)
+{
+	socket.close(error);
+}
+
+bool TcpTransport::isOpen()
+{
+	return socket.is_open();
+}
+
+void TcpTransport::asyncReadSome(char* data, size_t length, ReadHandler handler)
+{
+	socket.async_read_some(boost::asio::buffer(data, length), handler);
+}
+
+size_t TcpTransport::write(const vector<boost::asio::const_buffer>& buffers, boost::system::error_code& error)
+{
+	return boost::asio::write(socket, buffers, boost::asio::transfer_all(), error);
+}
+
+int TcpTransport::getNativeHandle()
+{
+	if(!socket.is_open())
+		return -1;
+	return socket.native_handle();
+}
+
+string TcpTransport::getName()
+{
+	return host+":"+port;
+}
+
+#ifndef _WIN32
+
+PtyTransport::PtyTransport(boost::asio::io_service& io_service, string link):
+master(io_service),
+slave(-1),
+link(link)
+{
+
+}
+
+PtyTransport::~PtyTransport()
+{
+	boost::system::error_code error;
+	close(error);
+}
+
+/*
+ * Create a new pseudo-terminal. The other side (the slave) is put
+ * into raw mode and, if a path was given, linked to that path so an
+ * other program can open it like a serial port.
+ */
+int PtyTransport::open()
+{
+	int fd=posix_openpt(O_RDWR | O_NOCTTY);
+	if(fd<0)
+		return -1;
+	if(grantpt(fd) || unlockpt(fd))
+	{
+		::close(fd);
+		return -1;
+	}
+	slaveName=ptsname(fd);
+	slave=::open(slaveName.c_str(), O_RDWR | O_NOCTTY);
+	if(slave<0)
+	{
+		::close(fd);
+		return -1;
+	}
+	struct termios settings;
+	tcgetattr(slave, &settings);
+	cfmakeraw(&settings);
+	tcsetattr(slave, TCSANOW, &settings);
+	if(link.length())
+	{
+		unlink(link.c_str());
+		if(symlink(slaveName.c_str(), link.c_str()))
+			cerr<<"PtyTransport::open(): Unable to link "<<slaveName<<" to "<<link<<endl;
+	}
+	master.assign(fd);
+	return 0;
+}
+
+void PtyTransport::close(boost::system::error_code& error)
+{
+	master.close(error);
+	if(slave>=0)
+	{
+		::close(slave);
+		slave=-1;
+		if(link.length())
+			unlink(link.c_str());
+	}
+}
+
+bool PtyTransport::isOpen()
+{
+	return master.is_open();
+}
+
+void PtyTransport::asyncReadSome(char* data, size_t length, ReadHandler handler)
+{
+	master.async_read_some(boost::asio::buffer(data, length), handler);
+}
+
+size_t PtyTransport::write(const vector<boost::asio::const_buffer>& buffers, boost::system::error_code& error)
+{
+	return boost::asio::write(master, buffers, boost::asio::transfer_all(), error);
+}
+
+int PtyTransport::getNativeHandle()
+{
+	if(!master.is_open())
+		return -1;
+	return master.native_handle();
+}
+
+/*
+ * Returns: The device name of the other side of the pseudo-terminal
+ */
+string PtyTransport::getName()
+{
+	return slaveName;
+}
+
+#endif
@@ -0,0 +1,117 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRANSPORT_HPP_
+#define TRANSPORT_HPP_
+
+#include <boost/asio.hpp>
+#include <boost/function.hpp>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*
+ * A Transport is the byte stream below the BoostComPort class. The
+ * BoostComPort does all the buffering, threading and recording, the
+ * transport only opens the connection and moves bytes.
+ * Transports are created from an URI by Transport::create():
+ *   serial:///dev/ttyUSB0?baud=250000  serial port (also COM3 or
+ *                                      /dev/ttyUSB0 without scheme)
+ *   tcp://host:port                    network attached printer or
+ *                                      serial to network bridge
+ *   pty:///tmp/printer                 new pseudo-terminal, the other
+ *                                      side is linked to the given path
+ *                                      (not on Windows)
+ */
+class Transport
+{
+public:
+	typedef boost::function<void (const boost::system::error_code&, std::size_t)> ReadHandler;
+
+	virtual ~Transport();
+	virtual int open()=0;
+	virtual void close(boost::system::error_code& error)=0;
+	virtual bool isOpen()=0;
+	virtual void asyncReadSome(char* data, size_t length, ReadHandler handler)=0;
+	virtual size_t write(const vector<boost::asio::const_buffer>& buffers, boost::system::error_code& error)=0;
+	virtual int getNativeHandle();
+	virtual string getName()=0;
+
+	static Transport* create(string uri, int baud, boost::asio::io_service& io_service);
+};
+
+class SerialTransport : public Transport
+{
+public:
+	SerialTransport(boost::asio::io_service& io_service, string device, int baud);
+	int open();
+	void close(boost::system::error_code& error);
+	bool isOpen();
+	void asyncReadSome(char* data, size_t length, ReadHandler handler);
+	size_t write(const vector<boost::asio::const_buffer>& buffers, boost::system::error_code& error);
+	int getNativeHandle();
+	string getName();
+
+private:
+	boost::asio::serial_port serialPort;
+	string device;
+	int baud;
+};
+
+class TcpTransport : public Transport
+{
+public:
+	TcpTransport(boost::asio::io_service& io_service, string host, string port);
+	int open();
+	void close(boost::system::error_code& error);
+	bool isOpen();
+	void asyncReadSome(char* data, size_t length, ReadHandler handler);
+	size_t write(const vector<boost::asio::const_buffer>& buffers, boost::system::error_code& error);
+	int getNativeHandle();
+	string getName();
+
+private:
+	boost::asio::io_service& io_service;
+	boost::asio::ip::tcp::socket socket;
+	string host;
+	string port;
+};
+
+#ifndef _WIN32
+class PtyTransport : public Transport
+{
+public:
+	PtyTransport(boost::asio::io_service& io_service, string link);
+	~PtyTransport();
+	int open();
+	void close(boost::system::error_code& error);
+	bool isOpen();
+	void asyncReadSome(char* data, size_t length, ReadHandler handler);
+	size_t write(const vector<boost::asio::const_buffer>& buffers, boost::system::error_code& error);
+	int getNativeHandle();
+	string getName();
+
+private:
+	boost::asio::posix::stream_descriptor master;
+	int slave;  // kept open so reading the master does not fail before the other side is opened
+	string slaveName;
+	string link;
+};
+#endif
+
+#endif /* TRANSPORT_HPP_ */
@@ -0,0 +1,70 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Benchmarks.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <boost/chrono.hpp>
+
+static ofstream resultFile;
+
+/*
+ * Returns: The text as a quoted CSV field
+ */
+static string quote(const string& text)
+{
+	string field="\"";
+	for(size_t i=0; i<text.length(); i++)
+	{
+		if(text[i]=='"')
+			field+='"';
+		field+=text[i];
+	}
+	return field+"\"";
+}
+
+double benchmarkTime()
+{
+	boost::chrono::duration<double> now=boost::chrono::steady_clock::now().time_since_epoch();
+	return now.count();
+}
+
+void reportResult(string benchmark, string variant, double value, string unit)
+{
+	cout<<left<<setw(24)<<benchmark<<setw(24)<<variant<<right<<setw(16)<<fixed<<setprecision(1)<<value<<" "<<unit<<endl;
+	if(resultFile.is_open())
+		resultFile<<quote(benchmark)<<","<<quote(variant)<<","<<setprecision(6)<<value<<","<<quote(unit)<<endl;
+}
+
+/*
+ * Write every result to a CSV file as well, one line with benchmark,
+ * variant, value and unit per result, so runs can be compared by
+ * scripts.
+ * Returns: 0 if the file is opened, -1 if not
+ */
+int openResultFile(string fileName)
+{
+	resultFile.open(fileName.c_str());
+	if(!resultFile)
+	{
+		cerr<<"openResultFile(): Unable to open "<<fileName<<endl;
+		return -1;
+	}
+	resultFile<<"benchmark,variant,value,unit"<<endl;
+	return 0;
+}
@@ -0,0 +1,48 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Microbenchmarks for the hot paths of the host. They are build by
+ * benchmarks.pro as a console program without Qt.
+ */
+
+#ifndef BENCHMARKS_H_
+#define BENCHMARKS_H_
+
+#include <string>
+
+using namespace std;
+
+double benchmarkTime();  // monotonic time in seconds
+void reportResult(string benchmark, string variant, double value, string unit);
+int openResultFile(string fileName);  // also write the results as CSV
+
+void runRingBufferBenchmark();
+void runLineScanBenchmark();
+void runStreamingBenchmark();
+void runWriteBenchmark();
+void runBinaryBenchmark();
+void runQueueBenchmark();
+void runLoaderBenchmark();
+void runParserBenchmark();
+void runChunkBenchmark();
+void runResendBenchmark();
+void runResponseBenchmark();
+void runTemperatureBenchmark();
+void runStatisticsBenchmark();
+void runCorpusBenchmark();
+void runFarmBenchmark();
+
+#endif /* BENCHMARKS_H_ */
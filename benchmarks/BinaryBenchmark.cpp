@@ -0,0 +1,90 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Bytes on the wire of ASCII lines compared with the binary protocol
+ * for a corpus of small extrusion segments, and the lines per second a
+ * 115200 baud link can carry with each of them.
+ */
+
+#include "Benchmarks.h"
+#include "BinaryGCode.hpp"
+#include <vector>
+#include <cstdio>
+
+#define CORPUS_LINES 100000
+#define LINK_BAUD 115200
+
+static vector<string> createCorpus()
+{
+	vector<string> corpus;
+	char line[100];
+	double e=0.0;
+	for(int i=0; i<CORPUS_LINES; i++)
+	{
+		if(i%1000==0)
+			snprintf(line, sizeof(line), "M104 S210.5");  // not encodable, sent as ASCII
+		else if(i%100==0)
+			snprintf(line, sizeof(line), "G0 Z%.2f F7800", 0.2+i/100*0.2);
+		else
+		{
+			e+=0.0321;
+			snprintf(line, sizeof(line), "G1 X%.3f Y%.3f E%.5f F1800", 100.0+(i%97)*0.613, 80.0+(i%89)*0.377, e);
+		}
+		char prefix[20];
+		snprintf(prefix, sizeof(prefix), "N%d ", i);
+		string numbered=string(prefix)+line+" *";
+		int checksum=0;
+		for(size_t j=0; j<numbered.length()-1; j++)
+			checksum^=(unsigned char)numbered[j];
+		snprintf(prefix, sizeof(prefix), "%d", checksum);
+		corpus.push_back(numbered+prefix);
+	}
+	return corpus;
+}
+
+void runBinaryBenchmark()
+{
+	vector<string> corpus=createCorpus();
+	size_t asciiBytes=0;
+	for(size_t i=0; i<corpus.size(); i++)
+		asciiBytes+=corpus[i].length()+1;
+
+	size_t binaryBytes=0;
+	size_t encoded=0;
+	string packet;
+	double start=benchmarkTime();
+	for(size_t i=0; i<corpus.size(); i++)
+	{
+		if(BinaryGCode::encode(corpus[i], BINARY_PROTOCOL_V2, packet)==0)
+		{
+			binaryBytes+=packet.length();
+			encoded++;
+		}
+		else
+			binaryBytes+=corpus[i].length()+1;
+	}
+	double elapsed=benchmarkTime()-start;
+
+	double asciiPerLine=(double)asciiBytes/corpus.size();
+	double binaryPerLine=(double)binaryBytes/corpus.size();
+	reportResult("wire encoding", "ascii", asciiPerLine, "bytes/line");
+	reportResult("wire encoding", "binary", binaryPerLine, "bytes/line");
+	reportResult("wire encoding", "binary encoded", 100.0*encoded/corpus.size(), "% of lines");
+	reportResult("wire encoding", "binary encoder", corpus.size()/elapsed, "lines/s");
+	// 10 bits per byte on the serial line (start, 8 data, stop)
+	reportResult("wire encoding", "ascii at 115200 baud", LINK_BAUD/10.0/asciiPerLine, "lines/s");
+	reportResult("wire encoding", "binary at 115200 baud", LINK_BAUD/10.0/binaryPerLine, "lines/s");
+}
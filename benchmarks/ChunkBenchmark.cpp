@@ -0,0 +1,80 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Time JobCache::create() needs for a large file with one thread and
+ * with one thread per processor. The caches written both ways have to
+ * be the same byte for byte.
+ */
+
+#include "Benchmarks.h"
+#include "JobCache.hpp"
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <boost/thread.hpp>
+
+#define CHUNK_LINES 2000000
+#define CHUNK_LAYER_LINES 5000
+
+static string createFile()
+{
+	string fileName="benchmark_chunks.gcode";
+	ofstream file(fileName.c_str());
+	file<<"; synthetic benchmark file\n";
+	file<<"G21\nG90\nG28\n";
+	char line[100];
+	for(int i=0; i<CHUNK_LINES; i++)
+	{
+		if(i%CHUNK_LAYER_LINES==0)
+			snprintf(line, sizeof(line), "G1 Z%.2f F7800\n", 0.2+i/CHUNK_LAYER_LINES*0.2);
+		else if(i%CHUNK_LAYER_LINES==1)
+			snprintf(line, sizeof(line), "G92 E0\n");
+		else if(i%3==0)
+			snprintf(line, sizeof(line), "G1 X%.3f Y%.3f E%.5f\n", 100.0+(i%97)*0.613, 80.0+(i%89)*0.377, (i%CHUNK_LAYER_LINES)*0.0321);
+		else
+			snprintf(line, sizeof(line), "G1 X%.3f Y%.3f E%.5f F%d ; segment %d\n", 100.0+(i%97)*0.613, 80.0+(i%89)*0.377, (i%CHUNK_LAYER_LINES)*0.0321, 1200+(i%4)*600, i);
+		file<<line;
+	}
+	return fileName;
+}
+
+static string readFile(string fileName)
+{
+	ifstream file(fileName.c_str(), ios::in | ios::binary);
+	ostringstream content;
+	content<<file.rdbuf();
+	return content.str();
+}
+
+void runChunkBenchmark()
+{
+	string fileName=createFile();
+	string cacheName=JobCache::getCacheName(fileName);
+	int threads=boost::thread::hardware_concurrency();
+	double start=benchmarkTime();
+	JobCache::create(fileName, 1);
+	reportResult("create cache", "1 thread", (benchmarkTime()-start)*1000.0, "ms");
+	string sequential=readFile(cacheName);
+	start=benchmarkTime();
+	JobCache::create(fileName, threads);
+	ostringstream variant;
+	variant<<threads<<" threads";
+	reportResult("create cache", variant.str(), (benchmarkTime()-start)*1000.0, "ms");
+	reportResult("create cache", "same cache", sequential==readFile(cacheName) ? 1.0 : 0.0, "");
+	remove(cacheName.c_str());
+	remove(fileName.c_str());
+}
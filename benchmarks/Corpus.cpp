@@ -0,0 +1,194 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Corpus.h"
+#include <fstream>
+#include <cstdio>
+#include <cmath>
+
+#define CORPUS_HEADER 6  // lines of the start G-code
+#define CORPUS_VASE_SEGMENTS 400  // segments of one turn of the vase
+#define CORPUS_LAYER_LINES 1000  // lines of a layer of the mixed corpus
+
+CorpusGenerator::CorpusGenerator(CorpusKind kind):
+kind(kind),
+line(0),
+x(100.0),
+y(100.0),
+z(0.2),
+e(0.0),
+angle(0.0),
+randomState(0x2545f4914f6cdd1dULL+kind)
+{
+}
+
+/*
+ * Returns: The next line of the corpus without line end
+ */
+string CorpusGenerator::next()
+{
+	const char* header[CORPUS_HEADER]={"G21", "G90", "M82", "M107", "G28", "G1 Z0.2 F7800"};
+	if(line<CORPUS_HEADER)
+		return header[line++];
+	long number=line++;
+	if(kind==CORPUS_VASE)
+		return vase();
+	if(kind==CORPUS_ARCS)
+		return arc();
+	if(kind==CORPUS_TRAVEL)
+		return travel();
+	
+	// mixed: layers of the other kinds, separated by layer changes
+	long layer=number/CORPUS_LAYER_LINES;
+	char text[100];
+	if(number%CORPUS_LAYER_LINES==0)
+	{
+		z+=0.2;
+		snprintf(text, sizeof(text), "G1 Z%.2f F7800 ; layer %ld", z, layer);
+		return text;
+	}
+	if(number%CORPUS_LAYER_LINES==1)
+		return layer%10==1 ? "M106 S255" : "G92 E0";
+	if(number%CORPUS_LAYER_LINES==2 && layer%50==0)
+		return "M104 S205";
+	if(layer%3==0)
+		return vase();
+	if(layer%3==1)
+		return arc();
+	return travel();
+}
+
+/*
+ * A turn of a slightly wavy circle, Z rises by a layer height per turn.
+ */
+string CorpusGenerator::vase()
+{
+	angle+=2.0*M_PI/CORPUS_VASE_SEGMENTS;
+	double radius=20.0+0.5*sin(angle*6.0);
+	double newX=100.0+radius*cos(angle);
+	double newY=100.0+radius*sin(angle);
+	e+=hypot(newX-x, newY-y)*0.033;
+	x=newX;
+	y=newY;
+	z+=0.2/CORPUS_VASE_SEGMENTS;
+	char text[100];
+	snprintf(text, sizeof(text), "G1 X%.3f Y%.3f Z%.4f E%.5f", x, y, z, e);
+	return text;
+}
+
+/*
+ * Arcs of about half a millimeter in alternating directions, like a
+ * slicer which fits arcs to small curves.
+ */
+string CorpusGenerator::arc()
+{
+	double i=0.3+random()*0.4;
+	double j=-0.3+random()*0.6;
+	double newX=x+0.5*(random()-0.3);
+	double newY=y+0.5*(random()-0.3);
+	if(newX<10.0 || newX>190.0)
+		newX=100.0;
+	if(newY<10.0 || newY>190.0)
+		newY=100.0;
+	e+=hypot(newX-x, newY-y)*0.035;
+	x=newX;
+	y=newY;
+	char text[100];
+	snprintf(text, sizeof(text), "G%d X%.3f Y%.3f I%.3f J%.3f E%.5f F1800", line%2 ? 2 : 3, x, y, i, j, e);
+	return text;
+}
+
+/*
+ * Cycles of retraction, Z hop, travel, unhop, unretraction and a few
+ * short extrusions.
+ */
+string CorpusGenerator::travel()
+{
+	char text[100];
+	switch(line%10)
+	{
+	case 0:
+		snprintf(text, sizeof(text), "G1 E%.5f F2400", e-1.0);
+		break;
+	case 1:
+		snprintf(text, sizeof(text), "G1 Z%.3f F7800", z+0.4);
+		break;
+	case 2:
+		x=10.0+random()*180.0;
+		y=10.0+random()*180.0;
+		snprintf(text, sizeof(text), "G0 X%.3f Y%.3f F9000 ; travel", x, y);
+		break;
+	case 3:
+		snprintf(text, sizeof(text), "G1 Z%.3f F7800", z);
+		break;
+	case 4:
+		snprintf(text, sizeof(text), "G1 E%.5f F2400", e);
+		break;
+	default:
+		x+=2.0*(random()-0.5);
+		y+=2.0*(random()-0.5);
+		e+=0.066;
+		snprintf(text, sizeof(text), "G1 X%.3f Y%.3f E%.5f F1500", x, y, e);
+		break;
+	}
+	return text;
+}
+
+/*
+ * Returns: A pseudo random number from 0.0 to 1.0 (xorshift64*), the
+ *          same sequence for every run
+ */
+double CorpusGenerator::random()
+{
+	randomState^=randomState>>12;
+	randomState^=randomState<<25;
+	randomState^=randomState>>27;
+	return ((randomState*0x2545f4914f6cdd1dULL)>>11)/9007199254740992.0;
+}
+
+vector<string> createCorpus(CorpusKind kind, long lines)
+{
+	CorpusGenerator generator(kind);
+	vector<string> corpus;
+	corpus.reserve(lines);
+	for(long i=0; i<lines; i++)
+		corpus.push_back(generator.next());
+	return corpus;
+}
+
+/*
+ * Write a corpus to a file, one line after the other.
+ * Returns: 0 if the file is written, -1 if not
+ */
+int writeCorpus(CorpusKind kind, long lines, string fileName)
+{
+	ofstream file(fileName.c_str());
+	if(!file)
+		return -1;
+	CorpusGenerator generator(kind);
+	for(long i=0; i<lines; i++)
+		file<<generator.next()<<'\n';
+	return file ? 0 : -1;
+}
+
+const char* getCorpusName(CorpusKind kind)
+{
+	const char* names[]={"vase", "arcs", "travel", "mixed"};
+	if(kind<0 || kind>=CORPUS_KINDS)
+		return "";
+	return names[kind];
+}
@@ -0,0 +1,68 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Deterministic synthetic G-code for the benchmarks. Every kind of
+ * corpus stresses another part of the host, the same kind and number
+ * of lines always give the same lines.
+ */
+
+#ifndef CORPUS_H_
+#define CORPUS_H_
+
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+
+using namespace std;
+
+enum CorpusKind
+{
+	CORPUS_VASE=0,  // a spiral vase: dense short G1 segments with X, Y, Z and E
+	CORPUS_ARCS,  // many tiny G2/G3 arcs
+	CORPUS_TRAVEL,  // long G0 travels with Z hops and retractions between short extrusions
+	CORPUS_MIXED,  // layers of the other kinds with comments and fan and temperature commands
+	CORPUS_KINDS
+};
+
+/*
+ * CorpusGenerator creates the lines of a corpus one by one, so files
+ * with millions of lines are written without keeping them in memory.
+ */
+class CorpusGenerator
+{
+public:
+	CorpusGenerator(CorpusKind kind);
+
+	string next();
+
+private:
+	string vase();
+	string arc();
+	string travel();
+	double random();
+
+	CorpusKind kind;
+	long line;
+	double x, y, z, e;
+	double angle;
+	boost::uint64_t randomState;
+};
+
+vector<string> createCorpus(CorpusKind kind, long lines);
+int writeCorpus(CorpusKind kind, long lines, string fileName);
+const char* getCorpusName(CorpusKind kind);
+
+#endif /* CORPUS_H_ */
@@ -0,0 +1,183 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * The hot paths of the host for each synthetic corpus (see Corpus.h):
+ * parsing with GCodeParser, rendering line numbers and checksums,
+ * queuing and sending commands while the remaining time is read, and
+ * streaming to the virtual printer end to end. A file with millions
+ * of lines is read and parsed like a job.
+ */
+
+#include "Benchmarks.h"
+#include "Corpus.h"
+#include "RepRapHost.h"
+#include "VirtualPrinter.h"
+#include <cstdio>
+#include <boost/thread.hpp>
+
+#define CORPUS_LINES 200000
+#define CORPUS_STREAM_LINES 3000
+#define CORPUS_FILE_LINES 2000000
+
+/*
+ * Gives access to the steps of sending a command without a port.
+ */
+class CorpusHost: public RepRapHost
+{
+public:
+	using RepRapHost::encodeCommand;
+	using RepRapHost::lineWritten;
+	using RepRapHost::takeNextCommand;
+};
+
+static void parse(const vector<string>& corpus, const string& variant)
+{
+	GCodeParser parser;
+	Command command;
+	double time=0.0;
+	double start=benchmarkTime();
+	for(size_t i=0; i<corpus.size(); i++)
+		if(!parser.parse(corpus[i], command))
+			time+=command.time;
+	reportResult("corpus parse", variant, corpus.size()/(benchmarkTime()-start), "lines/s");
+	reportResult("corpus print time", variant, time, "s");
+}
+
+static void render(const vector<string>& corpus, const string& variant)
+{
+	CorpusHost host;
+	host.setHashEnabled(true);
+	host.setNextLineNumber(0);
+	bool binary;
+	size_t bytes=0;
+	double start=benchmarkTime();
+	for(size_t i=0; i<corpus.size(); i++)
+	{
+		string line=host.encodeCommand(corpus[i], binary);
+		host.lineWritten(line);
+		bytes+=line.length();
+	}
+	reportResult("corpus render", variant, corpus.size()/(benchmarkTime()-start), "lines/s");
+	reportResult("corpus render", variant+" bytes", (double)bytes/corpus.size(), "B/line");
+}
+
+static void queue(const vector<string>& corpus, const string& variant)
+{
+	CorpusHost host;
+	double remaining=0.0;
+	double start=benchmarkTime();
+	for(size_t i=0; i<corpus.size(); i++)
+		host.addCommand(corpus[i]);
+	while(host.commandsLeft()>0)
+	{
+		host.takeNextCommand();
+		remaining+=host.getRemainingTime();
+	}
+	reportResult("corpus queue", variant, corpus.size()/(benchmarkTime()-start), "lines/s");
+	if(remaining<0.0)
+		cout<<"The remaining time is negative"<<endl;
+}
+
+#ifndef _WIN32
+
+static void stream(const vector<string>& corpus, const string& variant)
+{
+	VirtualPrinterSettings settings;
+	settings.baud=250000;
+	VirtualPrinter printer(settings);
+	if(printer.open())
+		return;
+	boost::thread firmware(boost::bind(&VirtualPrinter::run, &printer));
+	
+	RepRapHost host;
+	host.setStreamingEnabled(true);
+	host.setFirmwareBufferSize(settings.rxBufferSize);
+	if(host.connect(printer.getPortName(), 115200))
+	{
+		printer.stop();
+		firmware.join();
+		return;
+	}
+	for(size_t i=0; i<corpus.size() && i<CORPUS_STREAM_LINES; i++)
+		host.addCommand(corpus[i]);
+	double start=benchmarkTime();
+	while(!host.isIdle())
+	{
+		host.service();
+		boost::this_thread::sleep_for(boost::chrono::microseconds(100));
+	}
+	double elapsed=benchmarkTime()-start;
+	long lines=host.getLinesSent();
+	host.disconnect();
+	printer.stop();
+	firmware.join();
+	reportResult("corpus stream", variant, lines/elapsed, "lines/s");
+}
+
+#else
+
+static void stream(const vector<string>&, const string&)
+{
+}
+
+#endif
+
+/*
+ * Read and parse a file with millions of lines the way a job is
+ * read, see RepRapHost::setJob().
+ */
+static void file()
+{
+	string fileName="benchmark_corpus.gcode";
+	double start=benchmarkTime();
+	if(writeCorpus(CORPUS_MIXED, CORPUS_FILE_LINES, fileName))
+		return;
+	reportResult("corpus file", "write", CORPUS_FILE_LINES/(benchmarkTime()-start), "lines/s");
+	GCodeFile job;
+	if(job.open(fileName))
+	{
+		remove(fileName.c_str());
+		return;
+	}
+	GCodeParser parser;
+	Command command;
+	string line;
+	long lines=0;
+	start=benchmarkTime();
+	while(job.readLine(line))
+		if(!parser.parse(line, command))
+			lines++;
+	double elapsed=benchmarkTime()-start;
+	reportResult("corpus file", "read and parse", lines/elapsed, "lines/s");
+	reportResult("corpus file", "read and parse", job.getSize()/elapsed/1e6, "MB/s");
+	job.close();
+	remove(fileName.c_str());
+}
+
+void runCorpusBenchmark()
+{
+	for(int kind=0; kind<CORPUS_KINDS; kind++)
+	{
+		vector<string> corpus=createCorpus((CorpusKind)kind, CORPUS_LINES);
+		string variant=getCorpusName((CorpusKind)kind);
+		parse(corpus, variant);
+		render(corpus, variant);
+		queue(corpus, variant);
+		stream(corpus, variant);
+	}
+	file();
+}
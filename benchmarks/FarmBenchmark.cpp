@@ -0,0 +1,114 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Streams G1 moves to many virtual printers at once from one thread
+ * with PrinterFarm, all ports on one io_service. Reports the lines per
+ * second of all printers and of the slowest one, the CPU time the
+ * thread of the farm needs per line and the memory of a printer in
+ * the farm compared with a RepRapHost of its own.
+ */
+
+#include "Benchmarks.h"
+#include "PrinterFarm.h"
+#include "VirtualPrinter.h"
+#include <boost/thread.hpp>
+#include <boost/chrono/thread_clock.hpp>
+#include <sstream>
+
+#define FARM_PRINTERS 50
+#define FARM_LINES 1000
+
+#ifndef _WIN32
+
+/*
+ * The farm is destroyed before the virtual printers stop, so its ports
+ * are closed by the host side.
+ */
+static void streamToAll(const vector<VirtualPrinter*>& virtualPrinters, int rxBufferSize)
+{
+	PrinterFarm farm;
+	for(size_t i=0; i<virtualPrinters.size(); i++)
+	{
+		int index=farm.addPrinter(virtualPrinters[i]->getPortName(), 115200);
+		if(index<0)
+			return;
+		RepRapHost& host=farm.getPrinter(index);
+		host.setStreamingEnabled(true);
+		host.setFirmwareBufferSize(rxBufferSize);
+		for(int line=0; line<FARM_LINES; line++)
+			host.addCommand("G1 X"+host.double2String(line%100)+" Y"+host.double2String(line%37)+" F3000");
+	}
+	
+	farm.getReport();
+	boost::chrono::thread_clock::time_point cpuStart=boost::chrono::thread_clock::now();
+	double start=benchmarkTime();
+	farm.run(true);
+	double elapsed=benchmarkTime()-start;
+	double cpu=boost::chrono::duration<double>(boost::chrono::thread_clock::now()-cpuStart).count();
+	farm.getReport();
+	
+	double slowest=-1.0;
+	long lines=0;
+	for(int i=0; i<farm.getPrinterCount(); i++)
+	{
+		lines+=farm.getPrinter(i).getLinesSent();
+		if(slowest<0.0 || farm.getLinesPerSecond(i)<slowest)
+			slowest=farm.getLinesPerSecond(i);
+	}
+	ostringstream variant;
+	variant<<farm.getPrinterCount()<<" printers";
+	reportResult("farm", variant.str(), lines/elapsed, "lines/s");
+	reportResult("farm", "slowest printer", slowest, "lines/s");
+	reportResult("farm", "CPU per line", cpu*1e6/lines, "us");
+	reportResult("farm", "CPU load", cpu*100.0/elapsed, "%");
+}
+
+void runFarmBenchmark()
+{
+	reportResult("farm", "memory single host", (sizeof(RepRapHost)+BUFFER_SIZE)/1024.0, "KB");
+	reportResult("farm", "memory farm host", (sizeof(RepRapHost)+FARM_BUFFER_SIZE)/1024.0, "KB");
+	
+	VirtualPrinterSettings settings;
+	settings.baud=250000;
+	vector<VirtualPrinter*> virtualPrinters;
+	boost::thread_group firmwares;
+	for(int i=0; i<FARM_PRINTERS; i++)
+	{
+		VirtualPrinter* printer=new VirtualPrinter(settings);
+		if(printer->open())
+		{
+			delete printer;
+			break;
+		}
+		virtualPrinters.push_back(printer);
+		firmwares.create_thread(boost::bind(&VirtualPrinter::run, printer));
+	}
+	streamToAll(virtualPrinters, settings.rxBufferSize);
+	for(size_t i=0; i<virtualPrinters.size(); i++)
+		virtualPrinters[i]->stop();
+	firmwares.join_all();
+	for(size_t i=0; i<virtualPrinters.size(); i++)
+		delete virtualPrinters[i];
+}
+
+#else
+
+void runFarmBenchmark()
+{
+}
+
+#endif
@@ -0,0 +1,83 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Simulates the receive buffer growing in small chunks while the host
+ * searches for a delimiter after every chunk, like readUntil() does on
+ * every tick. The "rescan" variant is the old byte by byte search from
+ * the start of the buffer.
+ */
+
+#include "Benchmarks.h"
+#include "RingBuffer.hpp"
+#include <cstring>
+
+#define SCAN_BUFFER_SIZE 262144
+#define SCAN_CHUNK_SIZE 64
+
+static long rescan(RingBuffer& ring, const char* searchValue, size_t searchSize)
+{
+	for(size_t start=0; start+searchSize<=ring.size(); start++)
+	{
+		bool fits=true;
+		for(size_t pos=0; pos<searchSize; pos++)
+		{
+			if(ring.at(start+pos)!=searchValue[pos])
+			{
+				fits=false;
+				break;
+			}
+		}
+		if(fits)
+			return (long)start;
+	}
+	return -1;
+}
+
+static double scan(const char* searchValue, bool incremental)
+{
+	RingBuffer ring(SCAN_BUFFER_SIZE);
+	char chunk[SCAN_CHUNK_SIZE];
+	for(int i=0; i<SCAN_CHUNK_SIZE; i++)
+		chunk[i]="T:210.0 B:60.0 W:? "[i%19];  // temperature reports without line end
+	size_t searchSize=strlen(searchValue);
+	size_t searchedUntil=0;
+	long found=0;
+	double start=benchmarkTime();
+	while(ring.write(chunk, SCAN_CHUNK_SIZE)==SCAN_CHUNK_SIZE)
+	{
+		if(incremental)
+		{
+			found+=ring.find(searchValue, searchSize, searchedUntil);
+			searchedUntil=ring.size()-searchSize+1;
+		}
+		else
+		{
+			found+=rescan(ring, searchValue, searchSize);
+		}
+	}
+	double elapsed=benchmarkTime()-start;
+	if(found==0)
+		return 0.0;  // never happens, keeps the search from being optimized away
+	return ring.size()/elapsed;
+}
+
+void runLineScanBenchmark()
+{
+	reportResult("line scan \"\\n\"", "rescan", scan("\n", false)/1e6, "MB/s");
+	reportResult("line scan \"\\n\"", "incremental memchr", scan("\n", true)/1e6, "MB/s");
+	reportResult("line scan \"achieved\"", "rescan", scan("achieved", false)/1e6, "MB/s");
+	reportResult("line scan \"achieved\"", "incremental memchr", scan("achieved", true)/1e6, "MB/s");
+}
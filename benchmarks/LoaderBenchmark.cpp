@@ -0,0 +1,155 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Time until the first command of a G-code file can be sent. The
+ * "load all" variant queues every line of the file before sending like
+ * the execute button did before GCodeFile, the "lookahead" variant
+ * maps the file and only queues the lookahead window, the "job cache"
+ * variant maps the cache written by JobCache::create() before.
+ * The memory of a parsed command is compared as well: a Command with
+ * its text on the heap as the queue holds it, and a command in the
+ * job cache.
+ */
+
+#include "Benchmarks.h"
+#include "RepRapHost.h"
+#include <fstream>
+#include <cstdio>
+
+#define LOADER_LINES 200000
+
+static string createFile()
+{
+	string fileName="benchmark_loader.gcode";
+	ofstream file(fileName.c_str());
+	file<<"; synthetic benchmark file\n";
+	char line[100];
+	for(int i=0; i<LOADER_LINES; i++)
+	{
+		snprintf(line, sizeof(line), "G1 X%.3f Y%.3f E%.5f F1800 ; segment %d\n", 100.0+(i%97)*0.613, 80.0+(i%89)*0.377, i*0.0321, i);
+		file<<line;
+	}
+	return fileName;
+}
+
+static double loadAll(string fileName, size_t& queued)
+{
+	RepRapHost host;
+	host.setHashEnabled(false);
+	double start=benchmarkTime();
+	ifstream file(fileName.c_str());
+	string line;
+	while(getline(file, line))
+	{
+		size_t comment=line.find(';');
+		if(comment!=string::npos)
+			line=line.substr(0, comment);
+		while(line.length() && (line[line.length()-1]==' ' || line[line.length()-1]=='\r'))
+			line.erase(line.length()-1);
+		if(line.length())
+			host.addCommand(line);
+	}
+	double elapsed=benchmarkTime()-start;
+	queued=host.commandsLeft();
+	return elapsed;
+}
+
+static double loadLookahead(string fileName, size_t& queued)
+{
+	RepRapHost host;
+	host.setHashEnabled(false);
+	GCodeFile file;
+	double start=benchmarkTime();
+	file.open(fileName);
+	host.setJob(&file);
+	double elapsed=benchmarkTime()-start;
+	queued=host.commandsLeft();
+	return elapsed;
+}
+
+static double loadCache(string fileName, size_t& queued)
+{
+	RepRapHost host;
+	host.setHashEnabled(false);
+	JobCache cache;
+	double start=benchmarkTime();
+	if(cache.open(fileName))
+		return -1.0;
+	host.setJob(&cache);
+	double elapsed=benchmarkTime()-start;
+	queued=host.commandsLeft();
+	return elapsed;
+}
+
+/*
+ * Returns: The bytes per line of the file parsed into Commands, with
+ *          the heap memory of the command text
+ */
+static double commandSize(string fileName)
+{
+	GCodeFile file;
+	GCodeParser parser;
+	if(file.open(fileName))
+		return 0.0;
+	string line;
+	Command command;
+	size_t bytes=0;
+	size_t count=0;
+	while(file.readLine(line))
+	{
+		if(parser.parse(line, command))
+			continue;
+		bytes+=sizeof(Command);
+		if(command.command.capacity()>=sizeof(string))  // longer texts are not stored in the string itself
+			bytes+=command.command.capacity()+1;
+		count++;
+	}
+	return count ? (double)bytes/count : 0.0;
+}
+
+/*
+ * Returns: The bytes per command of the job cache of the file
+ */
+static double cacheSize(string fileName)
+{
+	JobCache cache;
+	if(cache.open(fileName) || cache.getCount()==0)
+		return 0.0;
+	ifstream file(JobCache::getCacheName(fileName).c_str(), ios::in | ios::binary | ios::ate);
+	return (double)file.tellg()/cache.getCount();
+}
+
+void runLoaderBenchmark()
+{
+	string fileName=createFile();
+	size_t queued;
+	double elapsed=loadAll(fileName, queued);
+	reportResult("time to first command", "load all", elapsed*1000.0, "ms");
+	reportResult("time to first command", "load all", queued, "queued commands");
+	elapsed=loadLookahead(fileName, queued);
+	reportResult("time to first command", "lookahead", elapsed*1000.0, "ms");
+	reportResult("time to first command", "lookahead", queued, "queued commands");
+	double start=benchmarkTime();
+	JobCache::create(fileName);
+	reportResult("time to first command", "create cache", (benchmarkTime()-start)*1000.0, "ms");
+	elapsed=loadCache(fileName, queued);
+	reportResult("time to first command", "job cache", elapsed*1000.0, "ms");
+	reportResult("time to first command", "job cache", queued, "queued commands");
+	reportResult("memory per command", "Command", commandSize(fileName), "bytes");
+	reportResult("memory per command", "job cache", cacheSize(fileName), "bytes");
+	remove(JobCache::getCacheName(fileName).c_str());
+	remove(fileName.c_str());
+}
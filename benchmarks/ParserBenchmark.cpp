@@ -0,0 +1,201 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Lines per second and MB per second parsed by GCodeParser, compared
+ * with the Boost.Spirit grammar it replaced. The old parser is kept
+ * here as the reference: it copies the line to upper case, runs the
+ * grammar (G/M and X/Y/Z/F/E only) and searches for '*'. The tokenizer
+ * (GCodeParser::read()) is compared with it, the whole parse() with
+ * the TimeEstimator in apply() is measured on its own, as well as the
+ * time of the estimator per line. Its print time is reported next to
+ * the one of the reference (distance divided by feedrate).
+ */
+
+#include "Benchmarks.h"
+#include "GCodeParser.hpp"
+#include <vector>
+#include <cstdio>
+#include <cmath>
+#include <boost/spirit/include/qi.hpp>
+#include <boost/spirit/include/phoenix_core.hpp>
+#include <boost/spirit/include/phoenix_operator.hpp>
+
+#define PARSER_LINES 200000
+#define PARSER_ROUNDS 5
+
+static vector<string> createCorpus()
+{
+	vector<string> corpus;
+	char line[100];
+	double e=0.0;
+	corpus.push_back("G1 F1800");
+	for(int i=1; i<PARSER_LINES; i++)
+	{
+		if(i%1000==0)
+			snprintf(line, sizeof(line), "M104 S210");
+		else if(i%500==0)
+			snprintf(line, sizeof(line), "G2 X%.3f Y%.3f I5.0 J-2.5 E%.5f", 100.0+(i%97)*0.613, 80.0+(i%89)*0.377, e);
+		else if(i%100==0)
+			snprintf(line, sizeof(line), "G0 Z%.2f F7800", 0.2+i/100*0.2);
+		else if(i%7==0)
+			snprintf(line, sizeof(line), "g1 x%.3f y%.3f e%.5f", 100.0+(i%97)*0.613, 80.0+(i%89)*0.377, e);
+		else
+			snprintf(line, sizeof(line), "G1 X%.3f Y%.3f E%.5f F1800", 100.0+(i%97)*0.613, 80.0+(i%89)*0.377, e);
+		e+=0.0321;
+		corpus.push_back(line);
+	}
+	return corpus;
+}
+
+struct SpiritParser
+{
+	double lastX, lastY, lastZ, lastF, lastE;
+
+	SpiritParser(): lastX(0.0), lastY(0.0), lastZ(0.0), lastF(0.0), lastE(0.0) {}
+
+	static string toUpper(string str)
+	{
+		for (unsigned int i=0;i<str.length();i++)
+			if (str[i] >= 0x61 && str[i] <= 0x7A)
+				str[i] = str[i] - 0x20;
+		return str;
+	}
+
+	int parse(string cmdStr, Command& command)
+	{
+		namespace qi = boost::spirit::qi;
+		namespace ascii = boost::spirit::ascii;
+		namespace phoenix = boost::phoenix;
+		using qi::double_;
+		using qi::int_;
+		using qi::_1;
+		using ascii::space;
+		using qi::lit;
+		using phoenix::ref;
+
+		int g=-1;
+		int m=-1;
+		double newX=lastX;
+		double newY=lastY;
+		double newZ=lastZ;
+		double newF=lastF;
+		double newE=lastE;
+		cmdStr=toUpper(cmdStr);
+		string::iterator begin=cmdStr.begin();
+		string::iterator end=cmdStr.end();
+		qi::phrase_parse(begin, end,
+				(
+						((lit('G') > int_[ref(g)=_1]) | (lit('M') > int_[ref(m)=_1]))
+						>>
+						(
+								(lit('X')>double_[ref(newX)=_1]) ^
+								(lit('Y')>double_[ref(newY)=_1]) ^
+								(lit('Z')>double_[ref(newZ)=_1]) ^
+								(lit('F')>double_[ref(newF)=_1]) ^
+								(lit('E')>double_[ref(newE)=_1])
+						)
+				),
+				space);
+		if(cmdStr.find("*")!=string::npos)
+			return -1;
+		command.id=0;
+		command.time=0.0;
+		command.jobTime=-1.0;
+		command.command=cmdStr;
+		command.m=m;
+		command.g=g;
+		command.x=newX;
+		command.y=newY;
+		command.z=newZ;
+		command.f=newF;
+		if(g==0 || g==1)
+		{
+			double dx=lastX-newX;
+			double dy=lastY-newY;
+			double dz=lastZ-newZ;
+			command.time=sqrt(dx*dx+dy*dy+dz*dz)/newF*60.0;
+		}
+		lastX=newX;
+		lastY=newY;
+		lastZ=newZ;
+		lastF=newF;
+		lastE=newE;
+		return 0;
+	}
+};
+
+/*
+ * Only the first step of GCodeParser::parse(), without positions and
+ * times.
+ */
+struct TokenizerParser
+{
+	GCodeParser parser;
+	GCodeMove move;
+
+	int parse(const string& line, Command& command)
+	{
+		return parser.read(line.data(), line.length(), command, move);
+	}
+};
+
+template<class Parser> static double parseCorpus(const vector<string>& corpus, double& positions, double& time)
+{
+	Command command;
+	double start=benchmarkTime();
+	for(int round=0; round<PARSER_ROUNDS; round++)
+	{
+		Parser parser;
+		positions=0.0;
+		time=0.0;
+		for(size_t i=0; i<corpus.size(); i++)
+			if(parser.parse(corpus[i], command)==0)
+			{
+				positions+=command.x+command.y+command.z;
+				time+=command.time;
+			}
+	}
+	return benchmarkTime()-start;
+}
+
+void runParserBenchmark()
+{
+	vector<string> corpus=createCorpus();
+	double bytes=0.0;
+	for(size_t i=0; i<corpus.size(); i++)
+		bytes+=corpus[i].length()+1;
+	bytes*=PARSER_ROUNDS;
+	double lines=(double)corpus.size()*PARSER_ROUNDS;
+
+	double spiritPositions, spiritTime;
+	double elapsed=parseCorpus<SpiritParser>(corpus, spiritPositions, spiritTime);
+	reportResult("parser", "spirit", lines/elapsed, "lines/s");
+	reportResult("parser", "spirit", bytes/elapsed/1e6, "MB/s");
+	double tokenizerPositions, tokenizerTime;
+	double tokenizerElapsed=parseCorpus<TokenizerParser>(corpus, tokenizerPositions, tokenizerTime);
+	reportResult("parser", "tokenizer", lines/tokenizerElapsed, "lines/s");
+	reportResult("parser", "tokenizer", bytes/tokenizerElapsed/1e6, "MB/s");
+	double parserPositions, parserTime;
+	elapsed=parseCorpus<GCodeParser>(corpus, parserPositions, parserTime);
+	reportResult("parser", "tokenizer + estimator", lines/elapsed, "lines/s");
+	reportResult("parser", "tokenizer + estimator", bytes/elapsed/1e6, "MB/s");
+	reportResult("parser", "estimator per line", (elapsed-tokenizerElapsed)/lines*1e9, "ns");
+	if(fabs(spiritPositions-parserPositions)>1e-6*fabs(spiritPositions))
+		reportResult("parser", "position difference", parserPositions-spiritPositions, "mm");
+	reportResult("print time", "distance/feedrate", spiritTime, "s");
+	reportResult("print time", "estimator", parserTime, "s");
+}
@@ -0,0 +1,84 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Cost of taking the first command out of the command queue depending
+ * on the length of the queue. The "vector" variant is the queue
+ * RepRapHost used before CommandQueue: erasing the first element moves
+ * all others.
+ */
+
+#include "Benchmarks.h"
+#include "CommandQueue.hpp"
+#include <vector>
+#include <cstdio>
+
+#define DEQUEUES 200
+
+static Command createCommand(int number)
+{
+	char line[100];
+	snprintf(line, sizeof(line), "N%d G1 X%.3f Y%.3f E%.5f F1800 *42", number, number*0.013, number*0.007, number*0.0321);
+	Command command;
+	command.id=0;
+	command.command=line;
+	command.time=0.01;
+	command.jobTime=-1.0;
+	command.m=-1;
+	command.g=1;
+	command.x=command.y=command.z=command.f=0.0;
+	return command;
+}
+
+static double dequeueVector(size_t length)
+{
+	vector<Command> commands;
+	for(size_t i=0; i<length; i++)
+		commands.push_back(createCommand(i));
+	double start=benchmarkTime();
+	for(int i=0; i<DEQUEUES; i++)
+	{
+		Command command=commands[0];
+		commands.erase(commands.begin());
+	}
+	return (benchmarkTime()-start)/DEQUEUES;
+}
+
+static double dequeueRing(size_t length)
+{
+	CommandQueue commands;
+	for(size_t i=0; i<length; i++)
+		commands.pushBack(createCommand(i));
+	double start=benchmarkTime();
+	for(int i=0; i<DEQUEUES; i++)
+	{
+		Command command=commands.front();
+		commands.popFront();
+	}
+	return (benchmarkTime()-start)/DEQUEUES;
+}
+
+void runQueueBenchmark()
+{
+	size_t lengths[]={1000, 10000, 100000, 1000000};
+	for(int i=0; i<4; i++)
+	{
+		char variant[50];
+		snprintf(variant, sizeof(variant), "vector, %lu queued", (unsigned long)lengths[i]);
+		reportResult("dequeue", variant, dequeueVector(lengths[i])*1e9, "ns/command");
+		snprintf(variant, sizeof(variant), "ring, %lu queued", (unsigned long)lengths[i]);
+		reportResult("dequeue", variant, dequeueRing(lengths[i])*1e9, "ns/command");
+	}
+}
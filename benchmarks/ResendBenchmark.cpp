@@ -0,0 +1,100 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Streams numbered G1 moves through RepRapHost to the virtual printer
+ * which corrupts received bytes with the given probability, so lines
+ * are rejected and written again from the line history. Reports the
+ * lines per second, the resend requests answered and the stalls the
+ * watchdog recovered. A lost line end or ok leaves the host waiting
+ * until the timeout, with and without streaming.
+ */
+
+#include "Benchmarks.h"
+#include "RepRapHost.h"
+#include "VirtualPrinter.h"
+#include <boost/thread.hpp>
+
+#ifndef _WIN32
+
+#define RESEND_STALL 2.0  // seconds without progress until a run is given up
+#define RESEND_TIMEOUT 0.2  // seconds until the watchdog recovers a stall
+
+static void resend(double noise, int lines, bool streaming)
+{
+	VirtualPrinterSettings settings;
+	settings.baud=250000;
+	settings.noise=noise;
+	VirtualPrinter printer(settings);
+	if(printer.open())
+		return;
+	boost::thread firmware(boost::bind(&VirtualPrinter::run, &printer));
+	
+	RepRapHost host;
+	host.setStreamingEnabled(streaming);
+	host.setTimeout(WAITING_FOR_OK, RESEND_TIMEOUT);
+	host.setFirmwareBufferSize(settings.rxBufferSize);
+	if(host.connect(printer.getPortName(), 115200))
+	{
+		printer.stop();
+		firmware.join();
+		return;
+	}
+	host.addCommand("M110 N-1");
+	for(int i=0; i<lines; i++)
+		host.addCommand("G1 X"+host.double2String(i%100)+" Y"+host.double2String(i%37)+" F3000");
+	double start=benchmarkTime();
+	double progress=start;
+	boost::uint64_t processed=0;
+	while(!host.isIdle() && benchmarkTime()-progress<RESEND_STALL)
+	{
+		host.service();
+		if(printer.getLinesProcessed()!=processed)
+		{
+			processed=printer.getLinesProcessed();
+			progress=benchmarkTime();
+		}
+		boost::this_thread::sleep_for(boost::chrono::microseconds(100));
+	}
+	double elapsed=progress-start;
+	bool completed=host.isIdle() && host.getRecoveries(RECOVERY_ABORT)==0;
+	host.disconnect();
+	printer.stop();
+	firmware.join();
+	
+	string variant=(streaming ? "streaming, noise " : "ping-pong, noise ")+host.double2String(noise);
+	reportResult("resend", variant, host.getLinesSent()/elapsed, "lines/s");
+	reportResult("resend", variant+" completed", completed, "");
+	reportResult("resend", variant+" resends", host.getResends(), "requests");
+	reportResult("resend", variant+" firmware errors", printer.getChecksumErrors(), "lines");
+	reportResult("resend", variant+" stalls", host.getStalls(), "recovered");
+}
+
+void runResendBenchmark()
+{
+	resend(0.0, 2000, true);
+	resend(0.0001, 2000, true);
+	resend(0.001, 2000, true);
+	resend(0.001, 1000, false);
+}
+
+#else
+
+void runResendBenchmark()
+{
+}
+
+#endif
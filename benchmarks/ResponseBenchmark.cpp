@@ -0,0 +1,119 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Responses of the firmware classified per second. The "regex" variant
+ * is the temperature parsing RepRapHost used before ResponseParser: a
+ * buffer allocated per response, boost::regex_search for the
+ * temperatures and istringstream to convert them.
+ */
+
+#include "Benchmarks.h"
+#include "ResponseParser.hpp"
+#include <vector>
+#include <sstream>
+#include <cstring>
+#include <boost/regex.hpp>
+
+#define RESPONSE_ROUNDS 20000
+
+static const char* responses[]=
+{
+	"ok\n",
+	"ok N10 P15 B3\n",
+	"ok T:210.0 /210.0 B:60.0 /60.0 @:127 B@:0\n",
+	"T:20.0 /0.0 B:20.0 /0.0 T0:20.0 /0.0 T1:21.5 /0.0 @:0 B@:0\n",
+	"T:205.3 E:0 W:?\n",
+	"echo:busy: processing\n",
+	"Error:checksum mismatch, Last Line: 11\n",
+	"Resend: 12\n",
+	"wait\n",
+	"Temperature achieved\n",
+	NULL
+};
+
+static double string2Double(string value)
+{
+	istringstream buffer(value);
+	double result;
+	buffer>>result;
+	return result;
+}
+
+static double parseRegex(const vector<string>& lines, double& sum)
+{
+	boost::regex tempExpression("([A-Z]): *([0-9]+.?[0-9]*)");
+	double start=benchmarkTime();
+	for(int round=0; round<RESPONSE_ROUNDS; round++)
+	{
+		for(size_t i=0; i<lines.size(); i++)
+		{
+			char* buffer=new char[1024];
+			memcpy(buffer, lines[i].c_str(), lines[i].length()+1);
+			string answer=buffer;
+			delete[] buffer;
+			string lower=answer;
+			for(size_t j=0; j<lower.length(); j++)
+				lower[j]=tolower(lower[j]);
+			if(lower.find("ok")!=string::npos)
+				sum+=1.0;
+			string::const_iterator begin=answer.begin();
+			string::const_iterator end=answer.end();
+			boost::match_results<string::const_iterator> what;
+			boost::match_flag_type flags=boost::match_default;
+			while(boost::regex_search(begin, end, what, tempExpression, flags))
+			{
+				sum+=string2Double(what[2]);
+				begin=what[0].second;
+				flags|=boost::match_prev_avail;
+				flags|=boost::match_not_bob;
+			}
+		}
+	}
+	return RESPONSE_ROUNDS*lines.size()/(benchmarkTime()-start);
+}
+
+static double parseTable(const vector<string>& lines, double& sum)
+{
+	FirmwareResponse response;
+	double start=benchmarkTime();
+	for(int round=0; round<RESPONSE_ROUNDS; round++)
+	{
+		for(size_t i=0; i<lines.size(); i++)
+		{
+			const char* line=lines[i].data();
+			ResponseParser::parse(line, line+lines[i].length(), response);
+			sum+=response.type;
+			if(response.hasTool)
+				sum+=response.tool;
+			if(response.hasBed)
+				sum+=response.bed;
+		}
+	}
+	return RESPONSE_ROUNDS*lines.size()/(benchmarkTime()-start);
+}
+
+void runResponseBenchmark()
+{
+	vector<string> lines;
+	for(int i=0; responses[i]; i++)
+		lines.push_back(responses[i]);
+	double sum=0.0;  // keeps the results used
+	reportResult("responses", "regex", parseRegex(lines, sum), "responses/s");
+	reportResult("responses", "table", parseTable(lines, sum), "responses/s");
+	if(sum<0.0)
+		reportResult("responses", "checksum", sum, "");
+}
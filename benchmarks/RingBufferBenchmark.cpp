@@ -0,0 +1,96 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Extracts temperature report lines one by one from a receive buffer
+ * with a large backlog. The "linear" variant is the receive buffer
+ * BoostComPort used before the ring buffer: every extracted line moves
+ * the rest of the buffer to the front.
+ */
+
+#include "Benchmarks.h"
+#include "RingBuffer.hpp"
+#include <cstring>
+
+#define BACKLOG_SIZE 1000000
+
+static const char* reportLine="ok T:201.3 /210.0 B:59.8 /60.0 @:127\n";
+
+static size_t fillBacklog(char* target, size_t size)
+{
+	size_t lineLength=strlen(reportLine);
+	size_t filled=0;
+	while(filled+lineLength<=size)
+	{
+		memcpy(target+filled, reportLine, lineLength);
+		filled+=lineLength;
+	}
+	return filled;
+}
+
+static double extractLinear(char* buffer, int currentContent)
+{
+	char line[1024];
+	size_t extracted=0;
+	double begin=benchmarkTime();
+	while(currentContent>0)
+	{
+		int start;
+		for(start=0; start<currentContent; start++)
+			if(buffer[start]=='\n')
+				break;
+		if(start==currentContent)
+			break;
+		memcpy(line, buffer, start+1);
+		memmove(buffer, buffer+start+1, currentContent-start-1);
+		currentContent-=start+1;
+		extracted+=start+1;
+	}
+	return extracted/(benchmarkTime()-begin);
+}
+
+static double extractRing(RingBuffer& ring)
+{
+	char line[1024];
+	size_t extracted=0;
+	double start=benchmarkTime();
+	while(true)
+	{
+		long end=ring.find("\n", 1);
+		if(end<0)
+			break;
+		extracted+=ring.read(line, end+1);
+	}
+	return extracted/(benchmarkTime()-start);
+}
+
+void runRingBufferBenchmark()
+{
+	char* backlog=new char[BACKLOG_SIZE];
+	size_t size=fillBacklog(backlog, BACKLOG_SIZE);
+
+	char* linear=new char[BACKLOG_SIZE];
+	memcpy(linear, backlog, size);
+	reportResult("receive buffer", "linear memmove", extractLinear(linear, size)/1e6, "MB/s");
+	delete[] linear;
+
+	RingBuffer ring(BACKLOG_SIZE);
+	ring.write(backlog, size/2);
+	ring.consume(size/2);  // move the read position to the middle to test wrapping
+	ring.write(backlog, size);
+	reportResult("receive buffer", "ring", extractRing(ring)/1e6, "MB/s");
+
+	delete[] backlog;
+}
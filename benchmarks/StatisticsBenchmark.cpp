@@ -0,0 +1,104 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Cost of the statistics on the hot path (reading the clock and adding
+ * a latency to a histogram, both done for every command), and the
+ * latencies and link utilization RepRapHost measures when it streams
+ * G1 moves to the virtual printer.
+ */
+
+#include "Benchmarks.h"
+#include "RepRapHost.h"
+#include "VirtualPrinter.h"
+#include <boost/thread.hpp>
+
+#define STATISTICS_ADDS 10000000
+#define STATISTICS_LINES 2000
+
+static void hotPath()
+{
+	LatencyHistogram histogram;
+	double start=benchmarkTime();
+	for(int i=0; i<STATISTICS_ADDS; i++)
+		histogram.add(i*(boost::int64_t)7919%5000000);
+	reportResult("statistics", "histogram add", (benchmarkTime()-start)*1e9/STATISTICS_ADDS, "ns");
+	reportResult("statistics", "histogram count", histogram.getCount(), "latencies");
+	boost::int64_t sum=0;
+	start=benchmarkTime();
+	for(int i=0; i<STATISTICS_ADDS; i++)
+		sum+=LinkStatistics::getTime();
+	reportResult("statistics", "clock read", (benchmarkTime()-start)*1e9/STATISTICS_ADDS, "ns");
+	if(sum==0)
+		cout<<"The clock does not run"<<endl;
+}
+
+#ifndef _WIN32
+
+static void streaming()
+{
+	VirtualPrinterSettings settings;
+	settings.baud=115200;
+	VirtualPrinter printer(settings);
+	if(printer.open())
+		return;
+	boost::thread firmware(boost::bind(&VirtualPrinter::run, &printer));
+	
+	RepRapHost host;
+	host.setStreamingEnabled(true);
+	host.setFirmwareBufferSize(settings.rxBufferSize);
+	if(host.connect(printer.getPortName(), settings.baud))
+	{
+		printer.stop();
+		firmware.join();
+		return;
+	}
+	for(int i=0; i<STATISTICS_LINES; i++)
+		host.addCommand("G1 X"+host.double2String(i%100)+" Y"+host.double2String(i%37)+" F3000");
+	host.getStatistics();
+	while(!host.isIdle())
+	{
+		host.service();
+		boost::this_thread::sleep_for(boost::chrono::microseconds(100));
+	}
+	const LinkStatistics& statistics=host.getStatistics();
+	host.disconnect();
+	printer.stop();
+	firmware.join();
+	
+	const LatencyHistogram& queued=statistics.getHistogram(LATENCY_QUEUED, COMMAND_MOVE);
+	const LatencyHistogram& acknowledged=statistics.getHistogram(LATENCY_ACKNOWLEDGED, COMMAND_MOVE);
+	reportResult("statistics", "G1 queued 50%", queued.getPercentile(0.5)*1000.0, "ms");
+	reportResult("statistics", "G1 acknowledged 50%", acknowledged.getPercentile(0.5)*1000.0, "ms");
+	reportResult("statistics", "G1 acknowledged 99%", acknowledged.getPercentile(0.99)*1000.0, "ms");
+	reportResult("statistics", "G1 acknowledged", acknowledged.getCount(), "commands");
+	reportResult("statistics", "link sent", statistics.getSentRate(), "B/s");
+	reportResult("statistics", "link utilization", statistics.getUtilization()*100.0, "%");
+}
+
+#else
+
+static void streaming()
+{
+}
+
+#endif
+
+void runStatisticsBenchmark()
+{
+	hotPath();
+	streaming();
+}
@@ -0,0 +1,182 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Streams short G1 moves through RepRapHost to a fake firmware on a
+ * pseudo-terminal and compares the lines per second of the send/ok
+ * ping-pong with the streaming mode. The host is either driven by a
+ * 10 ms tick like the GUI did before, or woken up when data arrives
+ * like the GUI does with its QSocketNotifier. With the I/O thread the
+ * host answers the oks in that thread, the 10 ms tick only refills it.
+ */
+
+#include "Benchmarks.h"
+#include "RepRapHost.h"
+#include <boost/thread.hpp>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <sys/select.h>
+
+#define FAKE_PROCESSING_TIME 200  // microseconds the fake firmware needs per line
+
+/*
+ * Answers every received line with ok after FAKE_PROCESSING_TIME.
+ */
+static void runFakeFirmware(int master, bool advancedOk)
+{
+	char buffer[256];
+	int lineNumber=0;
+	while(true)
+	{
+		int length=::read(master, buffer, sizeof(buffer));
+		if(length<=0)
+			return;
+		for(int i=0; i<length; i++)
+		{
+			if(buffer[i]!='\n')
+				continue;
+			boost::this_thread::sleep_for(boost::chrono::microseconds(FAKE_PROCESSING_TIME));
+			char answer[64];
+			if(advancedOk)
+				snprintf(answer, sizeof(answer), "ok N%d P15 B3\n", lineNumber);
+			else
+				snprintf(answer, sizeof(answer), "ok\n");
+			lineNumber++;
+			if(::write(master, answer, strlen(answer))<0)
+				return;
+		}
+	}
+}
+
+/*
+ * Wait until the port is readable or the timeout (in ms) is over, like
+ * the Qt event loop does for a QSocketNotifier.
+ */
+static void waitForData(RepRapHost& host, int timeout)
+{
+	int handle=host.getPortHandle();
+	fd_set readable;
+	FD_ZERO(&readable);
+	FD_SET(handle, &readable);
+	struct timeval time;
+	time.tv_sec=timeout/1000;
+	time.tv_usec=(timeout%1000)*1000;
+	select(handle+1, &readable, NULL, NULL, &time);
+}
+
+static double stream(bool streaming, int firmwareBufferSize, bool advancedOk, bool eventDriven, int lines, bool ioThread=false)
+{
+	int master=posix_openpt(O_RDWR | O_NOCTTY);
+	if(master<0 || grantpt(master) || unlockpt(master))
+		return 0.0;
+	struct termios settings;
+	tcgetattr(master, &settings);
+	cfmakeraw(&settings);
+	tcsetattr(master, TCSANOW, &settings);
+	
+	RepRapHost host;
+	host.setHashEnabled(false);
+	host.setStreamingEnabled(streaming);
+	host.setFirmwareBufferSize(firmwareBufferSize);
+	host.setIoThreadEnabled(ioThread);
+	if(host.connect(ptsname(master), 115200))
+		return 0.0;
+	boost::thread firmware(boost::bind(&runFakeFirmware, master, advancedOk));
+	for(int i=0; i<lines; i++)
+		host.addCommand("G1 X"+host.double2String(i%100)+" Y"+host.double2String(i%37)+" F3000");
+	double start=benchmarkTime();
+	if(eventDriven)
+		host.service();
+	while(host.getLinesSent()<lines)
+	{
+		if(eventDriven)
+		{
+			waitForData(host, 1000);
+			host.service();
+		}
+		else
+		{
+			host.timerTick();
+			boost::this_thread::sleep_for(boost::chrono::milliseconds(10));
+		}
+	}
+	double elapsed=benchmarkTime()-start;
+	host.disconnect();
+	::close(master);
+	firmware.join();
+	return lines/elapsed;
+}
+
+/*
+ * CPU time used in one second by an idle host which is driven by the
+ * tick or by received data.
+ */
+static double idle(bool eventDriven)
+{
+	int master=posix_openpt(O_RDWR | O_NOCTTY);
+	if(master<0 || grantpt(master) || unlockpt(master))
+		return 0.0;
+	RepRapHost host;
+	if(host.connect(ptsname(master), 115200))
+		return 0.0;
+	double start=benchmarkTime();
+	clock_t cpuStart=clock();
+	while(benchmarkTime()-start<1.0)
+	{
+		if(eventDriven)
+		{
+			waitForData(host, 1000);
+			host.service();
+		}
+		else
+		{
+			host.timerTick();
+			boost::this_thread::sleep_for(boost::chrono::milliseconds(10));
+		}
+	}
+	double cpu=(double)(clock()-cpuStart)/CLOCKS_PER_SEC;
+	host.disconnect();
+	::close(master);
+	return cpu*1e6;
+}
+
+void runStreamingBenchmark()
+{
+	reportResult("streaming 10ms tick", "ping-pong", stream(false, 63, false, false, 200), "lines/s");
+	reportResult("streaming 10ms tick", "window 63 bytes", stream(true, 63, false, false, 1000), "lines/s");
+	reportResult("streaming 10ms tick", "window 127 bytes", stream(true, 127, false, false, 2000), "lines/s");
+	reportResult("streaming 10ms tick", "window 127 + ok B3", stream(true, 127, true, false, 1000), "lines/s");
+	reportResult("streaming event", "ping-pong", stream(false, 63, false, true, 2000), "lines/s");
+	reportResult("streaming event", "window 127 bytes", stream(true, 127, false, true, 5000), "lines/s");
+	reportResult("streaming I/O thread", "ping-pong", stream(false, 63, false, false, 2000, true), "lines/s");
+	reportResult("streaming I/O thread", "window 127 bytes", stream(true, 127, false, false, 5000, true), "lines/s");
+	reportResult("idle CPU", "10ms tick", idle(false), "us/s");
+	reportResult("idle CPU", "event", idle(true), "us/s");
+}
+
+#else
+
+void runStreamingBenchmark()
+{
+}
+
+#endif
@@ -0,0 +1,105 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Streams G1 moves through RepRapHost to the virtual printer while
+ * the temperatures are monitored every second: by queuing M105 from a
+ * timer like the GUI did before, by polling when reports are missing
+ * and by automatic reports of the firmware (M155). Reports the lines
+ * per second, the M105 sent and the oldest temperatures seen.
+ */
+
+#include "Benchmarks.h"
+#include "RepRapHost.h"
+#include "VirtualPrinter.h"
+#include <boost/thread.hpp>
+
+#ifndef _WIN32
+
+#define TEMPERATURE_LINES 4000
+#define TEMPERATURE_MONITOR 1.0  // seconds between temperature updates
+
+enum TemperatureMonitor
+{
+	MONITOR_QUEUE=0,
+	MONITOR_POLL,
+	MONITOR_AUTO_REPORT
+};
+
+static void monitor(TemperatureMonitor mode)
+{
+	VirtualPrinterSettings settings;
+	VirtualPrinter printer(settings);
+	if(printer.open())
+		return;
+	boost::thread firmware(boost::bind(&VirtualPrinter::run, &printer));
+	
+	RepRapHost host;
+	host.setStreamingEnabled(true);
+	host.setFirmwareBufferSize(settings.rxBufferSize);
+	if(host.connect(printer.getPortName(), 115200))
+	{
+		printer.stop();
+		firmware.join();
+		return;
+	}
+	if(mode!=MONITOR_QUEUE)
+		host.setTemperatureInterval(TEMPERATURE_MONITOR, mode==MONITOR_AUTO_REPORT);
+	for(int i=0; i<TEMPERATURE_LINES; i++)
+		host.addCommand("G1 X"+host.double2String(i%100)+" Y"+host.double2String(i%37)+" F3000");
+	double start=benchmarkTime();
+	double nextQueued=start;
+	long queued=0;
+	double oldest=0.0;
+	while(!host.isIdle())
+	{
+		if(mode==MONITOR_QUEUE && benchmarkTime()>=nextQueued)
+		{
+			host.addCommand("M105", false, true);
+			nextQueued+=TEMPERATURE_MONITOR;
+			queued++;
+		}
+		host.service();
+		if(benchmarkTime()-start>TEMPERATURE_MONITOR && host.getTemperatureAge()>oldest)
+			oldest=host.getTemperatureAge();
+		boost::this_thread::sleep_for(boost::chrono::microseconds(100));
+	}
+	double elapsed=benchmarkTime()-start;
+	host.disconnect();
+	printer.stop();
+	firmware.join();
+	
+	const char* variants[]={"M105 queued", "polling", "auto report"};
+	string variant=variants[mode];
+	reportResult("temperatures", variant, printer.getLinesProcessed()/elapsed, "lines/s");
+	reportResult("temperatures", variant+" M105", mode==MONITOR_QUEUE ? queued : host.getTemperaturePolls(), "commands");
+	reportResult("temperatures", variant+" oldest", oldest, "s");
+}
+
+void runTemperatureBenchmark()
+{
+	monitor(MONITOR_QUEUE);
+	monitor(MONITOR_POLL);
+	monitor(MONITOR_AUTO_REPORT);
+}
+
+#else
+
+void runTemperatureBenchmark()
+{
+}
+
+#endif
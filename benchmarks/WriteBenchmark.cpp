@@ -0,0 +1,84 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Writes G-code lines to a pseudo-terminal, one write() per line
+ * compared with gather writes of several lines by writeLines().
+ */
+
+#include "Benchmarks.h"
+#include "BoostComPort.hpp"
+#include <boost/thread.hpp>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <cstdlib>
+
+#define WRITE_LINES 100000
+
+static void drain(int master)
+{
+	char buffer[4096];
+	while(::read(master, buffer, sizeof(buffer))>0);
+}
+
+static double writeBatched(int batchSize)
+{
+	int master=posix_openpt(O_RDWR | O_NOCTTY);
+	if(master<0 || grantpt(master) || unlockpt(master))
+		return 0.0;
+	struct termios settings;
+	tcgetattr(master, &settings);
+	cfmakeraw(&settings);
+	tcsetattr(master, TCSANOW, &settings);
+	
+	BoostComPort port;
+	if(port.open(ptsname(master), 115200))
+		return 0.0;
+	boost::thread reader(boost::bind(&drain, master));
+	vector<string> lines;
+	for(int i=0; i<batchSize; i++)
+		lines.push_back("N1234 G1 X123.456 Y78.9 E0.0321 F1800 *87\n");
+	double start=benchmarkTime();
+	for(int i=0; i<WRITE_LINES; i+=batchSize)
+	{
+		if(batchSize==1)
+			port.write((char*)lines[0].c_str(), lines[0].length());
+		else
+			port.writeLines(lines);
+	}
+	double elapsed=benchmarkTime()-start;
+	port.close();
+	::close(master);
+	reader.join();
+	return WRITE_LINES/elapsed;
+}
+
+void runWriteBenchmark()
+{
+	reportResult("serial write", "1 line per write", writeBatched(1), "lines/s");
+	reportResult("serial write", "8 lines per writev", writeBatched(8), "lines/s");
+	reportResult("serial write", "32 lines per writev", writeBatched(32), "lines/s");
+}
+
+#else
+
+void runWriteBenchmark()
+{
+}
+
+#endif
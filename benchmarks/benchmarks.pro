@@ -0,0 +1,62 @@
+TEMPLATE = app
+TARGET = RepRapBenchmarks
+CONFIG += console
+CONFIG -= qt
+INCLUDEPATH += .. \
+    ../virtualprinter \
+    ../daemon
+HEADERS += Benchmarks.h \
+    Corpus.h \
+    ../RingBuffer.hpp \
+    ../ConsoleTap.hpp \
+    ../Transport.hpp \
+    ../BoostComPort.hpp \
+    ../RepRapHost.h \
+    ../BinaryGCode.hpp \
+    ../GCodeTokenizer.hpp \
+    ../TimeEstimator.hpp \
+    ../CommandQueue.hpp \
+    ../GCodeFile.hpp \
+    ../GCodeParser.hpp \
+    ../JobCache.hpp \
+    ../LineHistory.hpp \
+    ../LinkStatistics.hpp \
+    ../ResponseParser.hpp \
+    ../virtualprinter/VirtualPrinter.h \
+    ../daemon/PrinterFarm.h
+SOURCES += main.cpp \
+    Benchmarks.cpp \
+    Corpus.cpp \
+    RingBufferBenchmark.cpp \
+    LineScanBenchmark.cpp \
+    StreamingBenchmark.cpp \
+    WriteBenchmark.cpp \
+    BinaryBenchmark.cpp \
+    QueueBenchmark.cpp \
+    LoaderBenchmark.cpp \
+    ParserBenchmark.cpp \
+    ChunkBenchmark.cpp \
+    ResendBenchmark.cpp \
+    ResponseBenchmark.cpp \
+    TemperatureBenchmark.cpp \
+    StatisticsBenchmark.cpp \
+    CorpusBenchmark.cpp \
+    FarmBenchmark.cpp \
+    ../RingBuffer.cpp \
+    ../ConsoleTap.cpp \
+    ../Transport.cpp \
+    ../BoostComPort.cpp \
+    ../RepRapHost.cpp \
+    ../BinaryGCode.cpp \
+    ../GCodeTokenizer.cpp \
+    ../TimeEstimator.cpp \
+    ../CommandQueue.cpp \
+    ../GCodeFile.cpp \
+    ../GCodeParser.cpp \
+    ../JobCache.cpp \
+    ../LineHistory.cpp \
+    ../LinkStatistics.cpp \
+    ../ResponseParser.cpp \
+    ../virtualprinter/VirtualPrinter.cpp \
+    ../daemon/PrinterFarm.cpp
+LIBS += -lboost_system -lboost_regex -lboost_thread -lboost_chrono
@@ -0,0 +1,87 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Benchmarks.h"
+#include <iostream>
+#include <cstring>
+
+struct Benchmark
+{
+	const char* name;
+	void (*run)();
+};
+
+static const Benchmark benchmarks[]=
+{
+	{"ringbuffer", runRingBufferBenchmark},
+	{"linescan", runLineScanBenchmark},
+	{"streaming", runStreamingBenchmark},
+	{"write", runWriteBenchmark},
+	{"binary", runBinaryBenchmark},
+	{"queue", runQueueBenchmark},
+	{"loader", runLoaderBenchmark},
+	{"parser", runParserBenchmark},
+	{"chunk", runChunkBenchmark},
+	{"resend", runResendBenchmark},
+	{"response", runResponseBenchmark},
+	{"temperature", runTemperatureBenchmark},
+	{"statistics", runStatisticsBenchmark},
+	{"corpus", runCorpusBenchmark},
+	{"farm", runFarmBenchmark}
+};
+
+static const int benchmarkCount=sizeof(benchmarks)/sizeof(benchmarks[0]);
+
+static void usage()
+{
+	cout<<"Usage: RepRapBenchmarks [--csv file] [benchmark...]"<<endl;
+	cout<<"Runs the given benchmarks or all of them and writes the results"<<endl;
+	cout<<"to a CSV file as well with --csv. Benchmarks:"<<endl;
+	for(int i=0; i<benchmarkCount; i++)
+		cout<<"  "<<benchmarks[i].name<<endl;
+}
+
+int main(int argc, char** argv)
+{
+	bool selected[benchmarkCount];
+	bool any=false;
+	for(int i=0; i<benchmarkCount; i++)
+		selected[i]=false;
+	for(int arg=1; arg<argc; arg++)
+	{
+		if(strcmp(argv[arg], "--csv")==0 && arg+1<argc)
+		{
+			if(openResultFile(argv[++arg]))
+				return 1;
+			continue;
+		}
+		int i=0;
+		while(i<benchmarkCount && strcmp(argv[arg], benchmarks[i].name)!=0)
+			i++;
+		if(i==benchmarkCount)
+		{
+			usage();
+			return strcmp(argv[arg], "--help")==0 ? 0 : 1;
+		}
+		selected[i]=true;
+		any=true;
+	}
+	for(int i=0; i<benchmarkCount; i++)
+		if(selected[i] || !any)
+			benchmarks[i].run();
+	return 0;
+}
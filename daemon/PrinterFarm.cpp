@@ -0,0 +1,218 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PrinterFarm.h"
+#include <sstream>
+#include <iomanip>
+#include <boost/bind.hpp>
+#include <boost/chrono.hpp>
+
+static double now()
+{
+	boost::chrono::duration<double> time=boost::chrono::steady_clock::now().time_since_epoch();
+	return time.count();
+}
+
+PrinterFarm::Printer::Printer(boost::asio::io_service* service, size_t bufferSize, string port):
+host(service, bufferSize),
+port(port),
+reportedLines(0),
+portEvents(0),
+linesPerSecond(0.0)
+{
+}
+
+PrinterFarm::PrinterFarm(size_t bufferSize):
+tick(service),
+tickRunning(false),
+bufferSize(bufferSize),
+running(false),
+reportInterval(0.0),
+lastReport(now())
+{
+}
+
+PrinterFarm::~PrinterFarm()
+{
+	for(size_t i=0; i<printers.size(); i++)
+	{
+		printers[i]->host.disconnect();
+		delete printers[i];
+	}
+}
+
+/*
+ * Connect a printer. It is configured like a single RepRapHost, see
+ * getPrinter().
+ * Returns: The index of the printer, -1 if the port can not be opened
+ */
+int PrinterFarm::addPrinter(string port, int baud)
+{
+	Printer* printer=new Printer(&service, bufferSize, port);
+	if(printer->host.connect(port, baud))
+	{
+		cerr<<"PrinterFarm::addPrinter(): Unable to open "<<port<<endl;
+		delete printer;
+		return -1;
+	}
+	printers.push_back(printer);
+	return printers.size()-1;
+}
+
+int PrinterFarm::getPrinterCount()
+{
+	return printers.size();
+}
+
+RepRapHost& PrinterFarm::getPrinter(int index)
+{
+	return printers[index]->host;
+}
+
+/*
+ * Send a G-code file to a printer.
+ * Returns: 0 if the file is opened, -1 if not
+ */
+int PrinterFarm::setJob(int index, string fileName)
+{
+	Printer* printer=printers[index];
+	if(printer->job.open(fileName))
+	{
+		cerr<<"PrinterFarm::setJob(): Unable to open "<<fileName<<endl;
+		return -1;
+	}
+	printer->host.setJob(&printer->job);
+	return 0;
+}
+
+/*
+ * Returns: true if no printer has anything to send or to wait for
+ */
+bool PrinterFarm::isIdle()
+{
+	for(size_t i=0; i<printers.size(); i++)
+		if(!printers[i]->host.isIdle())
+			return false;
+	return true;
+}
+
+/*
+ * Service the printers until stop() is called, or until all of them
+ * are idle.
+ */
+void PrinterFarm::run(bool untilIdle)
+{
+	running=true;
+	while(running && !(untilIdle && isIdle()))
+	{
+		runOnce();
+		if(reportInterval>0.0 && now()-lastReport>=reportInterval)
+			cout<<getReport();
+	}
+}
+
+/*
+ * Wait until a port received data or the tick expired and run all
+ * handlers which are ready. Only the printers whose read handler ran
+ * are serviced, every printer when the tick expired.
+ */
+void PrinterFarm::runOnce()
+{
+	startTick();
+	service.reset();
+	service.run_one();
+	service.poll();
+	bool ticked=!tickRunning;
+	for(size_t i=0; i<printers.size(); i++)
+	{
+		Printer* printer=printers[i];
+		long events=printer->host.getPortEvents();
+		if(!ticked && events==printer->portEvents)
+			continue;
+		printer->portEvents=events;
+		printer->host.service();
+	}
+}
+
+/*
+ * Let run() return, may be called from a signal handler.
+ */
+void PrinterFarm::stop()
+{
+	running=false;
+}
+
+void PrinterFarm::startTick()
+{
+	if(tickRunning)
+		return;
+	tickRunning=true;
+	tick.expires_from_now(boost::posix_time::milliseconds(FARM_TICK));
+	tick.async_wait(boost::bind(&PrinterFarm::onTick, this, boost::asio::placeholders::error));
+}
+
+void PrinterFarm::onTick(const boost::system::error_code&)
+{
+	tickRunning=false;
+}
+
+/*
+ * Print a report of all printers every given seconds while run() is
+ * running, 0 stops it.
+ */
+void PrinterFarm::setReportInterval(double seconds)
+{
+	reportInterval=seconds;
+}
+
+/*
+ * Returns: The lines per second sent to a printer between the last
+ *          two reports
+ */
+double PrinterFarm::getLinesPerSecond(int index)
+{
+	return printers[index]->linesPerSecond;
+}
+
+/*
+ * Returns: A line per printer with its port, the lines per second
+ *          sent since the last report, the lines sent and its state,
+ *          and a line with the sums
+ */
+string PrinterFarm::getReport()
+{
+	double time=now();
+	double seconds=time-lastReport;
+	lastReport=time;
+	ostringstream report;
+	report<<fixed<<setprecision(1);
+	double sum=0.0;
+	long lines=0;
+	for(size_t i=0; i<printers.size(); i++)
+	{
+		Printer* printer=printers[i];
+		long sent=printer->host.getLinesSent();
+		if(seconds>0.0)
+			printer->linesPerSecond=(sent-printer->reportedLines)/seconds;
+		printer->reportedLines=sent;
+		sum+=printer->linesPerSecond;
+		lines+=sent;
+		report<<printer->port<<": "<<printer->linesPerSecond<<" lines/s, "<<sent<<" lines, "<<(printer->host.isIdle() ? "idle" : "printing")<<endl;
+	}
+	report<<printers.size()<<" printers: "<<sum<<" lines/s, "<<lines<<" lines"<<endl;
+	return report.str();
+}
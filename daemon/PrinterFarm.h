@@ -0,0 +1,88 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PRINTERFARM_H_
+#define PRINTERFARM_H_
+
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/atomic.hpp>
+#include "RepRapHost.h"
+#include "GCodeFile.hpp"
+
+#define FARM_BUFFER_SIZE 16384  // receive buffer per printer, answers are taken out after every event
+#define FARM_TICK 10  // milliseconds between services of all printers, also those without received data
+
+using namespace std;
+
+/*
+ * PrinterFarm drives many printers from one thread: every printer has
+ * its own RepRapHost, but all ports share one io_service and a receive
+ * buffer of bufferSize bytes instead of BUFFER_SIZE, no port has an
+ * I/O thread. run() waits until any port received data or the tick
+ * expired, then services the printers whose port received data or lost
+ * its connection, and all printers on the tick (for timeouts,
+ * temperature polls and new commands).
+ */
+class PrinterFarm
+{
+public:
+	PrinterFarm(size_t bufferSize=FARM_BUFFER_SIZE);
+	~PrinterFarm();
+
+	int addPrinter(string port, int baud);
+	int getPrinterCount();
+	RepRapHost& getPrinter(int index);
+	int setJob(int index, string fileName);
+	bool isIdle();
+
+	void run(bool untilIdle=false);
+	void runOnce();
+	void stop();
+
+	void setReportInterval(double seconds);
+	double getLinesPerSecond(int index);
+	string getReport();
+
+private:
+	struct Printer
+	{
+		Printer(boost::asio::io_service* service, size_t bufferSize, string port);
+
+		RepRapHost host;
+		GCodeFile job;
+		string port;
+		long reportedLines;  // lines sent at the last getReport()
+		long portEvents;  // read events of the port at the last service
+		double linesPerSecond;
+	};
+
+	void startTick();
+	void onTick(const boost::system::error_code& error);
+
+	boost::asio::io_service service;
+	boost::asio::deadline_timer tick;
+	bool tickRunning;
+	size_t bufferSize;
+	vector<Printer*> printers;
+	boost::atomic<bool> running;
+	double reportInterval;  // seconds between reports of run(), 0=no reports
+	double lastReport;
+};
+
+#endif /* PRINTERFARM_H_ */
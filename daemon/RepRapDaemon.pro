@@ -0,0 +1,39 @@
+TEMPLATE = app
+TARGET = RepRapDaemon
+CONFIG += console
+CONFIG -= qt
+INCLUDEPATH += ..
+HEADERS += PrinterFarm.h \
+    ../RingBuffer.hpp \
+    ../ConsoleTap.hpp \
+    ../Transport.hpp \
+    ../BoostComPort.hpp \
+    ../RepRapHost.h \
+    ../BinaryGCode.hpp \
+    ../GCodeTokenizer.hpp \
+    ../TimeEstimator.hpp \
+    ../CommandQueue.hpp \
+    ../GCodeFile.hpp \
+    ../GCodeParser.hpp \
+    ../JobCache.hpp \
+    ../LineHistory.hpp \
+    ../LinkStatistics.hpp \
+    ../ResponseParser.hpp
+SOURCES += main.cpp \
+    PrinterFarm.cpp \
+    ../RingBuffer.cpp \
+    ../ConsoleTap.cpp \
+    ../Transport.cpp \
+    ../BoostComPort.cpp \
+    ../RepRapHost.cpp \
+    ../BinaryGCode.cpp \
+    ../GCodeTokenizer.cpp \
+    ../TimeEstimator.cpp \
+    ../CommandQueue.cpp \
+    ../GCodeFile.cpp \
+    ../GCodeParser.cpp \
+    ../JobCache.cpp \
+    ../LineHistory.cpp \
+    ../LinkStatistics.cpp \
+    ../ResponseParser.cpp
+LIBS += -lboost_system -lboost_thread -lboost_chrono
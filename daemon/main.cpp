@@ -0,0 +1,137 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PrinterFarm.h"
+#include <iostream>
+#include <cstdlib>
+#include <csignal>
+
+static PrinterFarm* farm=NULL;
+
+static void onSignal(int)
+{
+	if(farm)
+		farm->stop();
+}
+
+/*
+ * Find the '=' between a port and its file. The parameters in the query
+ * of an URI have an '=' of their own, so the file of
+ * serial:///dev/ttyUSB0?baud=250000=a.gcode follows the second one.
+ * Returns: The position of the separator or string::npos if no file is given
+ */
+static size_t findFileSeparator(const string& argument)
+{
+	size_t pos=argument.find("://");
+	if(pos!=string::npos)
+		pos=argument.find('?', pos);
+	if(pos==string::npos || argument.find('=')<pos)
+		return argument.find('=');
+	while(pos!=string::npos)
+	{
+		pos=argument.find('=', pos+1);  // of the parameter
+		if(pos==string::npos)
+			break;
+		pos=argument.find_first_of("&=", pos+1);
+		if(pos!=string::npos && argument[pos]=='=')
+			return pos;
+	}
+	return string::npos;
+}
+
+static void printUsage()
+{
+	cout<<"Usage: RepRapDaemon [options] <port>[=<file>]..."<<endl;
+	cout<<"Sends the G-code files to the printers on the given ports (devices"<<endl;
+	cout<<"or URIs, see Transport.hpp) from one thread, until all are done."<<endl;
+	cout<<"  --baud <rate>            baud rate of the following ports (115200)"<<endl;
+	cout<<"  --streaming <bytes>      stream to firmwares with this receive buffer"<<endl;
+	cout<<"  --hash                   send line numbers and checksums"<<endl;
+	cout<<"  --buffer <bytes>         receive buffer per port (16384)"<<endl;
+	cout<<"  --report <seconds>       print lines per second of every printer (10)"<<endl;
+}
+
+int main(int argc, char *argv[])
+{
+	int baud=115200;
+	int streaming=0;
+	bool hash=false;
+	size_t bufferSize=FARM_BUFFER_SIZE;
+	double report=10.0;
+	vector<string> ports;
+	vector<int> bauds;
+	for(int i=1; i<argc; i++)
+	{
+		string option=argv[i];
+		bool hasValue=i+1<argc;
+		if(option=="--hash")
+			hash=true;
+		else if(option=="--baud" && hasValue)
+			baud=atoi(argv[++i]);
+		else if(option=="--streaming" && hasValue)
+			streaming=atoi(argv[++i]);
+		else if(option=="--buffer" && hasValue)
+			bufferSize=strtoul(argv[++i], NULL, 10);
+		else if(option=="--report" && hasValue)
+			report=atof(argv[++i]);
+		else if(option.compare(0, 2, "--")!=0)
+		{
+			ports.push_back(option);
+			bauds.push_back(baud);
+		}
+		else
+		{
+			printUsage();
+			return option=="--help" ? 0 : 1;
+		}
+	}
+	if(ports.empty() || bufferSize==0)
+	{
+		printUsage();
+		return 1;
+	}
+
+	PrinterFarm printerFarm(bufferSize);
+	for(size_t i=0; i<ports.size(); i++)
+	{
+		size_t separator=findFileSeparator(ports[i]);
+		string port=ports[i].substr(0, separator);
+		int index=printerFarm.addPrinter(port, bauds[i]);
+		if(index<0)
+			return 1;
+		RepRapHost& host=printerFarm.getPrinter(index);
+		host.setStreamingEnabled(streaming>0);
+		if(streaming>0)
+			host.setFirmwareBufferSize(streaming);
+		host.setHashEnabled(hash);
+		if(hash)
+			host.addCommand("M110 N-1");
+		if(separator!=string::npos && printerFarm.setJob(index, ports[i].substr(separator+1)))
+			return 1;
+	}
+	cout<<"Driving "<<printerFarm.getPrinterCount()<<" printers"<<endl;
+
+	farm=&printerFarm;
+	signal(SIGINT, onSignal);
+	signal(SIGTERM, onSignal);
+	printerFarm.setReportInterval(report);
+	printerFarm.run(true);
+	farm=NULL;
+
+	cout<<printerFarm.getReport();
+	return 0;
+}
@@ -0,0 +1,592 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "VirtualPrinter.h"
+#include "BinaryGCode.hpp"
+#include <iostream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <cmath>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/select.h>
+#include <boost/chrono.hpp>
+
+#define AMBIENT_TEMPERATURE 20.0
+#define PLANNER_SIZE 16  // reported as free planner slots in advanced ok answers
+
+VirtualPrinterSettings::VirtualPrinterSettings():
+baud(115200),
+rxBufferSize(63),
+commandBufferSize(4),
+processingTime(200),
+noise(0.0),
+heatRate(5.0),
+advancedOk(false),
+inlineTemperatures(false),
+binary(false),
+seed(1),
+verbose(false)
+{
+
+}
+
+VirtualPrinter::VirtualPrinter(VirtualPrinterSettings settings):
+settings(settings),
+master(-1),
+hostConnected(false),
+running(false),
+nextByteTime(0.0),
+processing(false),
+processingDone(0.0),
+waitingForHeaters(false),
+nextReport(0.0),
+autoReportInterval(0.0),
+lastLine(-1),
+extruder(AMBIENT_TEMPERATURE),
+extruderTarget(0.0),
+bed(AMBIENT_TEMPERATURE),
+bedTarget(0.0),
+lastUpdate(0.0),
+x(0.0),
+y(0.0),
+z(0.0),
+e(0.0),
+randomState(settings.seed ? settings.seed : 1),
+linesProcessed(0),
+checksumErrors(0),
+overflowBytes(0)
+{
+
+}
+
+VirtualPrinter::~VirtualPrinter()
+{
+	close();
+}
+
+/*
+ * Create the pseudo-terminal. Its other side is put into raw mode and
+ * linked to settings.link if given.
+ * Returns: 0 on success
+ */
+int VirtualPrinter::open()
+{
+	master=posix_openpt(O_RDWR | O_NOCTTY);
+	if(master<0)
+		return -1;
+	if(grantpt(master) || unlockpt(master))
+	{
+		close();
+		return -1;
+	}
+	slaveName=ptsname(master);
+	int slave=::open(slaveName.c_str(), O_RDWR | O_NOCTTY);
+	if(slave<0)
+	{
+		close();
+		return -1;
+	}
+	struct termios terminal;
+	tcgetattr(slave, &terminal);
+	cfmakeraw(&terminal);
+	tcsetattr(slave, TCSANOW, &terminal);
+	::close(slave);
+	fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+	if(settings.link.length())
+	{
+		unlink(settings.link.c_str());
+		if(symlink(slaveName.c_str(), settings.link.c_str()))
+			cerr<<"VirtualPrinter::open(): Unable to link "<<slaveName<<" to "<<settings.link<<endl;
+	}
+	lastUpdate=now();
+	return 0;
+}
+
+void VirtualPrinter::close()
+{
+	if(master>=0)
+	{
+		::close(master);
+		master=-1;
+		if(settings.link.length())
+			unlink(settings.link.c_str());
+	}
+}
+
+/*
+ * Returns: The device the host has to open
+ */
+string VirtualPrinter::getPortName()
+{
+	if(settings.link.length())
+		return settings.link;
+	return slaveName;
+}
+
+/*
+ * Emulate the firmware until stop() is called (may be called from an
+ * other thread).
+ */
+void VirtualPrinter::run()
+{
+	running=true;
+	while(running)
+	{
+		double time=now();
+		receive(time);
+		moveLines();
+		processCommands(time);
+		updateTemperatures(time);
+
+		// sleep until the next thing happens or the host sends something
+		double wakeUp=time+0.1;
+		if(!wire.empty() && nextByteTime<wakeUp)
+			wakeUp=nextByteTime;
+		if(processing && !waitingForHeaters && processingDone<wakeUp)
+			wakeUp=processingDone;
+		if(autoReportInterval>0.0 && nextReport<wakeUp)
+			wakeUp=nextReport;
+		double timeout=wakeUp-now();
+		if(timeout<0.0)
+			timeout=0.0;
+		if(!hostConnected && timeout>0.01)
+			timeout=0.01;
+		struct timeval wait;
+		wait.tv_sec=(long)timeout;
+		wait.tv_usec=(long)((timeout-wait.tv_sec)*1e6);
+		if(!hostConnected)
+		{
+			// the master is always readable (EIO) without a host, so
+			// only sleep and look for a host again
+			select(0, NULL, NULL, NULL, &wait);
+			continue;
+		}
+		fd_set readable;
+		FD_ZERO(&readable);
+		FD_SET(master, &readable);
+		select(master+1, &readable, NULL, NULL, &wait);
+	}
+}
+
+void VirtualPrinter::stop()
+{
+	running=false;
+}
+
+boost::uint64_t VirtualPrinter::getLinesProcessed()
+{
+	return linesProcessed;
+}
+
+boost::uint64_t VirtualPrinter::getChecksumErrors()
+{
+	return checksumErrors;
+}
+
+boost::uint64_t VirtualPrinter::getOverflowBytes()
+{
+	return overflowBytes;
+}
+
+/*
+ * Forget everything like a board after a reset.
+ */
+void VirtualPrinter::reset()
+{
+	wire.clear();
+	rxBuffer.clear();
+	commandBuffer.clear();
+	processing=false;
+	waitingForHeaters=false;
+	autoReportInterval=0.0;
+	lastLine=-1;
+	extruderTarget=0.0;
+	bedTarget=0.0;
+}
+
+/*
+ * Take what the host has written and let it arrive in the receive
+ * buffer at the speed of the simulated baud rate. Bytes arriving at
+ * a full receive buffer are lost, like on a real microcontroller.
+ */
+void VirtualPrinter::receive(double time)
+{
+	char data[4096];
+	int length;
+	while((length=::read(master, data, sizeof(data)))>0)
+	{
+		hostConnected=true;
+		if(wire.empty() && nextByteTime<time)
+			nextByteTime=time;
+		wire.insert(wire.end(), data, data+length);
+	}
+	if(length<0 && errno==EIO && hostConnected)
+	{
+		if(settings.verbose)
+			cout<<"Host disconnected"<<endl;
+		hostConnected=false;
+		reset();
+	}
+	double byteTime=settings.baud>0 ? 10.0/settings.baud : 0.0;
+	while(!wire.empty() && (byteTime==0.0 || nextByteTime+byteTime<=time))
+	{
+		char byte=wire.front();
+		wire.pop_front();
+		nextByteTime+=byteTime;
+		if(settings.noise>0.0 && random()<settings.noise)
+			byte^=1<<(int)(random()*7);
+		if((int)rxBuffer.size()<settings.rxBufferSize)
+			rxBuffer.push_back(byte);
+		else
+			overflowBytes++;
+	}
+}
+
+/*
+ * Move complete lines from the receive buffer into the command buffer
+ * while there is room.
+ */
+void VirtualPrinter::moveLines()
+{
+	while((int)commandBuffer.size()<settings.commandBufferSize)
+	{
+		if(settings.binary && !rxBuffer.empty() && (rxBuffer.front() & 0x80))
+		{
+			if(!moveBinaryPacket())
+				return;
+			continue;
+		}
+		deque<char>::iterator end=find(rxBuffer.begin(), rxBuffer.end(), '\n');
+		if(end==rxBuffer.end())
+			return;
+		string line(rxBuffer.begin(), end);
+		rxBuffer.erase(rxBuffer.begin(), end+1);
+		if(line.length() && line[line.length()-1]=='\r')
+			line.erase(line.length()-1);
+		if(line.length())
+			commandBuffer.push_back(line);
+	}
+}
+
+/*
+ * Move a binary packet from the receive buffer into the command
+ * buffer. It is stored as ASCII line with a checksum, so it is checked
+ * and executed like every other line.
+ * Returns: false if the packet is not complete yet
+ */
+bool VirtualPrinter::moveBinaryPacket()
+{
+	char header[5];
+	size_t length=min(rxBuffer.size(), sizeof(header));
+	copy(rxBuffer.begin(), rxBuffer.begin()+length, header);
+	int size=BinaryGCode::packetSize(header, length);
+	if(size==0 || size>(int)rxBuffer.size())
+		return false;
+	string packet(rxBuffer.begin(), rxBuffer.begin()+size);
+	rxBuffer.erase(rxBuffer.begin(), rxBuffer.begin()+size);
+	string line;
+	if(BinaryGCode::decode(packet.c_str(), packet.length(), line))
+	{
+		commandBuffer.push_back("N");  // fails the checksum test and requests a resend
+		return true;
+	}
+	int checksum=0;
+	line+=" *";
+	for(size_t i=0; i<line.length()-1; i++)
+		checksum^=(unsigned char)line[i];
+	ostringstream checked;
+	checked<<line<<checksum;
+	commandBuffer.push_back(checked.str());
+	return true;
+}
+
+/*
+ * Returns: The seconds a G4 command waits, 0 for other commands
+ */
+static double dwellTime(const string& line)
+{
+	size_t start=0;
+	if(line[0]=='N' || line[0]=='n')
+	{
+		start=line.find(' ');
+		if(start==string::npos)
+			return 0.0;
+		start++;
+	}
+	if(line.compare(start, 3, "G4 ")!=0 && line.compare(start, 3, "g4 ")!=0)
+		return 0.0;
+	size_t p=line.find('P', start);
+	if(p==string::npos)
+		return 0.0;
+	return atof(line.c_str()+p+1)/1000.0;
+}
+
+void VirtualPrinter::processCommands(double time)
+{
+	while(true)
+	{
+		if(waitingForHeaters)
+		{
+			if(!heatingDone())
+				return;
+			waitingForHeaters=false;
+			answer("Temperature achieved");
+			acknowledge();
+			commandBuffer.pop_front();
+			processing=false;
+		}
+		if(processing)
+		{
+			if(time<processingDone)
+				return;
+			processing=false;
+			string line=commandBuffer.front();
+			executeCommand(line, time);
+			if(waitingForHeaters)
+				return;
+			commandBuffer.pop_front();
+			moveLines();
+		}
+		if(commandBuffer.empty())
+			return;
+		processing=true;
+		processingDone=time+settings.processingTime*1e-6+dwellTime(commandBuffer.front());
+		if(processingDone>time)
+			return;
+	}
+}
+
+/*
+ * Check the line number and the checksum of a line and remove both
+ * from the line.
+ * Returns: false if the line has to be resent
+ */
+bool VirtualPrinter::checkLine(string& line)
+{
+	if(line[0]!='N' && line[0]!='n')
+		return true;
+	long number=atol(line.c_str()+1);
+	size_t star=line.find('*');
+	if(star==string::npos)
+	{
+		checksumErrors++;  // numbered lines need a checksum
+		return false;
+	}
+	int checksum=0;
+	for(size_t i=0; i<star; i++)
+		checksum^=(unsigned char)line[i];
+	if(checksum!=atoi(line.c_str()+star+1))
+	{
+		checksumErrors++;
+		return false;
+	}
+	size_t space=line.find(' ');
+	string command=line.substr(space+1, star-space-1);
+	while(command.length() && command[command.length()-1]==' ')
+		command.erase(command.length()-1);
+	if(command.compare(0, 4, "M110")==0)
+	{
+		// like Marlin, an N argument wins over the line number
+		size_t argument=command.find('N', 4);
+		if(argument!=string::npos)
+			number=atol(command.c_str()+argument+1);
+		lastLine=number-1;
+	}
+	long expected=lastLine+1;
+	if(lastLine>=0 && number!=expected)
+	{
+		// binary packets only carry the low 16 bits of the line number
+		if(!settings.binary || (number & 0xffff)!=(expected & 0xffff))
+			return false;
+		number=expected;
+	}
+	lastLine=number;
+	line=command;
+	return true;
+}
+
+void VirtualPrinter::executeCommand(string line, double time)
+{
+	linesProcessed++;
+	if(settings.verbose)
+		cout<<"Received: "<<line<<endl;
+	if(!checkLine(line))
+	{
+		ostringstream error;
+		error<<"Error:Line or checksum error, Last Line: "<<lastLine<<"\nResend: "<<lastLine+1;
+		answer(error.str());
+		acknowledge();
+		return;
+	}
+	for(unsigned int i=0; i<line.length(); i++)
+		line[i]=toupper(line[i]);
+	char code=line[0];
+	int number=atoi(line.c_str()+1);
+	double s=0.0;
+	bool hasS=false;
+	istringstream words(line);
+	string word;
+	while(words>>word)
+	{
+		double value=atof(word.c_str()+1);
+		switch(word[0])
+		{
+		case 'S': s=value; hasS=true; break;
+		case 'X': if(code=='G') x=value; break;
+		case 'Y': if(code=='G') y=value; break;
+		case 'Z': if(code=='G') z=value; break;
+		case 'E': if(code=='G') e=value; break;
+		}
+	}
+	if(code=='M')
+	{
+		switch(number)
+		{
+		case 104:
+			extruderTarget=s;
+			break;
+		case 140:
+			bedTarget=s;
+			break;
+		case 105:
+			if(settings.inlineTemperatures)
+			{
+				answer("ok "+temperatures());
+				return;
+			}
+			answer(temperatures());
+			break;
+		case 109:
+			if(hasS)
+				extruderTarget=s;
+			waitingForHeaters=true;
+			nextReport=time+1.0;
+			return;
+		case 190:
+			if(hasS)
+				bedTarget=s;
+			waitingForHeaters=true;
+			nextReport=time+1.0;
+			return;
+		case 116:
+			waitingForHeaters=true;
+			nextReport=time+1.0;
+			return;
+		case 114:
+		{
+			ostringstream position;
+			position<<"X:"<<x<<" Y:"<<y<<" Z:"<<z<<" E:"<<e;
+			answer(position.str());
+			break;
+		}
+		case 115:
+			if(settings.binary)
+				answer("FIRMWARE_NAME:VirtualPrinter REPETIER_PROTOCOL:2");
+			else
+				answer("FIRMWARE_NAME:VirtualPrinter");
+			break;
+		case 155:
+			autoReportInterval=s;
+			nextReport=time+s;
+			break;
+		}
+	}
+	acknowledge();
+}
+
+bool VirtualPrinter::heatingDone()
+{
+	return fabs(extruder-(extruderTarget>0.0 ? extruderTarget : AMBIENT_TEMPERATURE))<1.0 &&
+		fabs(bed-(bedTarget>0.0 ? bedTarget : AMBIENT_TEMPERATURE))<1.0;
+}
+
+/*
+ * Move the temperatures towards their targets and send the reports
+ * while waiting for the heaters or when M155 is active.
+ */
+void VirtualPrinter::updateTemperatures(double time)
+{
+	double step=(time-lastUpdate)*settings.heatRate;
+	lastUpdate=time;
+	double target=extruderTarget>0.0 ? extruderTarget : AMBIENT_TEMPERATURE;
+	extruder+=fabs(target-extruder)<step ? target-extruder : (target>extruder ? step : -step);
+	target=bedTarget>0.0 ? bedTarget : AMBIENT_TEMPERATURE;
+	bed+=fabs(target-bed)<step ? target-bed : (target>bed ? step : -step);
+	if(waitingForHeaters && time>=nextReport)
+	{
+		answer(temperatures()+" W:?");
+		nextReport=time+1.0;
+	}
+	else if(!waitingForHeaters && autoReportInterval>0.0 && time>=nextReport)
+	{
+		answer(temperatures());
+		nextReport=time+autoReportInterval;
+	}
+}
+
+void VirtualPrinter::answer(string text)
+{
+	if(settings.verbose)
+		cout<<"Answer: "<<text<<endl;
+	if(!hostConnected)
+		return;
+	text+="\n";
+	if(::write(master, text.c_str(), text.length())<0)
+		cerr<<"VirtualPrinter::answer(): Unable to write the answer"<<endl;
+}
+
+void VirtualPrinter::acknowledge()
+{
+	if(!settings.advancedOk)
+	{
+		answer("ok");
+		return;
+	}
+	ostringstream ok;
+	ok<<"ok N"<<(lastLine>=0 ? lastLine : 0)<<" P"<<PLANNER_SIZE<<" B"<<settings.commandBufferSize-(int)commandBuffer.size()+1;
+	answer(ok.str());
+}
+
+string VirtualPrinter::temperatures()
+{
+	char text[100];
+	snprintf(text, sizeof(text), "T:%.1f /%.1f B:%.1f /%.1f", extruder, extruderTarget, bed, bedTarget);
+	return text;
+}
+
+double VirtualPrinter::now()
+{
+	boost::chrono::duration<double> time=boost::chrono::steady_clock::now().time_since_epoch();
+	return time.count();
+}
+
+/*
+ * Reproducible pseudo random number in [0, 1) (xorshift)
+ */
+double VirtualPrinter::random()
+{
+	randomState^=randomState<<13;
+	randomState^=randomState>>7;
+	randomState^=randomState<<17;
+	return (randomState>>11)*(1.0/9007199254740992.0);
+}
@@ -0,0 +1,122 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VIRTUALPRINTER_H_
+#define VIRTUALPRINTER_H_
+
+#include <string>
+#include <deque>
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+
+using namespace std;
+
+struct VirtualPrinterSettings
+{
+	VirtualPrinterSettings();
+
+	string link;  // path the pseudo-terminal is linked to, empty for none
+	int baud;  // simulated baud rate of the received data, 0=unlimited
+	int rxBufferSize;  // serial receive buffer in bytes, overflowing bytes are lost
+	int commandBufferSize;  // command buffer in lines
+	int processingTime;  // microseconds to process one command
+	double noise;  // probability that a received byte is corrupted
+	double heatRate;  // degrees per second the heaters change
+	bool advancedOk;  // answer "ok N<line> P<planner> B<buffer>"
+	bool inlineTemperatures;  // answer M105 with "ok T:.. B:.." instead of "T:.. B:..\nok"
+	bool binary;  // accept packets of the binary protocol (see BinaryGCode.hpp)
+	unsigned int seed;  // seed for the noise
+	bool verbose;
+};
+
+/*
+ * VirtualPrinter emulates the serial side of a RepRap firmware on a
+ * pseudo-terminal, so the host can be tested and benchmarked without
+ * a printer. Hosts open the other side of the pseudo-terminal like a
+ * normal serial port.
+ * Received bytes arrive paced by the simulated baud rate in a receive
+ * buffer of limited size, complete lines are moved into the command
+ * buffer and every command takes processingTime to be processed before
+ * it is acknowledged with ok. Line numbers and checksums are checked,
+ * errors are answered with Resend:. Optionally packets of the binary
+ * protocol are accepted as well. M105 reports simulated
+ * temperatures, M109, M190 and M116 wait until the heaters reached
+ * their target and M155 enables automatic temperature reports.
+ * Sent answers are not paced. When the host closes the port the
+ * printer resets, like a board with auto reset on connect.
+ */
+class VirtualPrinter
+{
+public:
+	VirtualPrinter(VirtualPrinterSettings settings);
+	~VirtualPrinter();
+
+	int open();
+	void close();
+	string getPortName();
+	void run();
+	void stop();
+
+	boost::uint64_t getLinesProcessed();
+	boost::uint64_t getChecksumErrors();
+	boost::uint64_t getOverflowBytes();
+
+private:
+	void reset();
+	void receive(double now);
+	void moveLines();
+	bool moveBinaryPacket();
+	void processCommands(double now);
+	bool checkLine(string& line);
+	void executeCommand(string line, double now);
+	bool heatingDone();
+	void updateTemperatures(double now);
+	void answer(string text);
+	void acknowledge();
+	string temperatures();
+	double now();
+	double random();
+
+	VirtualPrinterSettings settings;
+	int master;
+	bool hostConnected;  // false while no host has the pseudo-terminal open
+	string slaveName;
+	boost::atomic<bool> running;
+
+	deque<char> wire;  // bytes written by the host but not arrived yet
+	double nextByteTime;
+	deque<char> rxBuffer;
+	deque<string> commandBuffer;
+	bool processing;
+	double processingDone;
+	bool waitingForHeaters;
+	double nextReport;
+	double autoReportInterval;  // seconds between automatic temperature reports, 0=off
+	long lastLine;  // last line number, -1 until the first numbered line is received
+
+	double extruder, extruderTarget;
+	double bed, bedTarget;
+	double lastUpdate;
+	double x, y, z, e;
+	boost::uint64_t randomState;
+
+	boost::uint64_t linesProcessed;
+	boost::uint64_t checksumErrors;
+	boost::uint64_t overflowBytes;
+};
+
+#endif /* VIRTUALPRINTER_H_ */
@@ -0,0 +1,13 @@
+TEMPLATE = app
+TARGET = VirtualPrinter
+CONFIG += console
+CONFIG -= qt
+INCLUDEPATH += ..
+HEADERS += VirtualPrinter.h \
+    ../BinaryGCode.hpp \
+    ../GCodeTokenizer.hpp
+SOURCES += main.cpp \
+    VirtualPrinter.cpp \
+    ../BinaryGCode.cpp \
+    ../GCodeTokenizer.cpp
+LIBS += -lboost_system -lboost_chrono
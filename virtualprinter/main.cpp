@@ -0,0 +1,105 @@
+/*
+ * This file is part of RepRap Minihost.
+ *
+ * RepRap Minihost is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RepRap Minihost is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RepRap Minihost.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "VirtualPrinter.h"
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+
+static VirtualPrinter* printer=NULL;
+
+static void onSignal(int)
+{
+	if(printer)
+		printer->stop();
+}
+
+static void printUsage()
+{
+	cout<<"Usage: VirtualPrinter [options]"<<endl;
+	cout<<"  --link <path>            link the pseudo-terminal to path"<<endl;
+	cout<<"  --baud <rate>            simulated baud rate, 0=unlimited (115200)"<<endl;
+	cout<<"  --rx-buffer <bytes>      serial receive buffer size (63)"<<endl;
+	cout<<"  --command-buffer <lines> command buffer size (4)"<<endl;
+	cout<<"  --processing-time <us>   time to process one command (200)"<<endl;
+	cout<<"  --noise <probability>    probability that a received byte is corrupted (0)"<<endl;
+	cout<<"  --heat-rate <degrees/s>  speed of the heaters (5)"<<endl;
+	cout<<"  --advanced-ok            answer ok N<line> P<planner> B<buffer>"<<endl;
+	cout<<"  --inline-temperatures    answer M105 with ok T:.."<<endl;
+	cout<<"  --binary                 accept the binary G-code protocol"<<endl;
+	cout<<"  --seed <number>          seed of the noise (1)"<<endl;
+	cout<<"  --verbose                print all commands and answers"<<endl;
+}
+
+int main(int argc, char *argv[])
+{
+	VirtualPrinterSettings settings;
+	for(int i=1; i<argc; i++)
+	{
+		string option=argv[i];
+		bool hasValue=i+1<argc;
+		if(option=="--advanced-ok")
+			settings.advancedOk=true;
+		else if(option=="--inline-temperatures")
+			settings.inlineTemperatures=true;
+		else if(option=="--binary")
+			settings.binary=true;
+		else if(option=="--verbose")
+			settings.verbose=true;
+		else if(option=="--link" && hasValue)
+			settings.link=argv[++i];
+		else if(option=="--baud" && hasValue)
+			settings.baud=atoi(argv[++i]);
+		else if(option=="--rx-buffer" && hasValue)
+			settings.rxBufferSize=atoi(argv[++i]);
+		else if(option=="--command-buffer" && hasValue)
+			settings.commandBufferSize=atoi(argv[++i]);
+		else if(option=="--processing-time" && hasValue)
+			settings.processingTime=atoi(argv[++i]);
+		else if(option=="--noise" && hasValue)
+			settings.noise=atof(argv[++i]);
+		else if(option=="--heat-rate" && hasValue)
+			settings.heatRate=atof(argv[++i]);
+		else if(option=="--seed" && hasValue)
+			settings.seed=strtoul(argv[++i], NULL, 10);
+		else
+		{
+			printUsage();
+			return option=="--help" ? 0 : 1;
+		}
+	}
+
+	VirtualPrinter virtualPrinter(settings);
+	if(virtualPrinter.open())
+	{
+		cerr<<"Unable to open a pseudo-terminal"<<endl;
+		return 1;
+	}
+	cout<<"Virtual printer listening on "<<virtualPrinter.getPortName()<<endl;
+
+	printer=&virtualPrinter;
+	signal(SIGINT, onSignal);
+	signal(SIGTERM, onSignal);
+	virtualPrinter.run();
+	printer=NULL;
+
+	cout<<"Lines processed: "<<virtualPrinter.getLinesProcessed()<<endl;
+	cout<<"Checksum errors: "<<virtualPrinter.getChecksumErrors()<<endl;
+	cout<<"Lost bytes: "<<virtualPrinter.getOverflowBytes()<<endl;
+	return 0;
+}